@@ -31,6 +31,7 @@
 #include "uenv.h"
 #include "support.h"
 #include "gbnd.h"
+#include "ubnd.h" /* sameuQ */
 #include "hlayer.h"
 
 #if defined(ROUND)
@@ -140,16 +141,14 @@ signed long g2si(const gbnd_s *g)
 {
 	int inf;
 	signed long rop;
-	mpf_t tmpf;
+	MPF_VAR(tmpf);
 
 	if (g->nan) return 0;
-	mpf_init2(tmpf, PBITS);
 	inf = midpoint(tmpf, g);
 	/* TODO: round? */
 	if (inf < 0 || mpf_cmp_si(tmpf, LONG_MIN) < 0) rop = LONG_MIN;
 	else if (inf > 0 || mpf_cmp_si(tmpf, LONG_MAX) > 0) rop = LONG_MAX;
 	else rop = mpf_get_si(tmpf);
-	mpf_clear(tmpf);
 	return(rop);
 }
 
@@ -157,16 +156,14 @@ unsigned long g2ui(const gbnd_s *g)
 {
 	int inf;
 	unsigned long rop;
-	mpf_t tmpf;
+	MPF_VAR(tmpf);
 
 	if (g->nan) return 0;
-	mpf_init2(tmpf, PBITS);
 	inf = midpoint(tmpf, g);
 	/* TODO: round? */
 	if (inf < 0 || mpf_sgn(tmpf) < 0) rop = 0;
 	else if (inf > 0 || mpf_cmp_ui(tmpf, ULONG_MAX) > 0) rop = ULONG_MAX;
 	else rop = mpf_get_ui(tmpf);
-	mpf_clear(tmpf);
 	return(rop);
 }
 
@@ -174,35 +171,29 @@ double g2d(const gbnd_s *g)
 {
 	int inf;
 	double rop;
-	mpf_t tmpf;
+	MPF_VAR(tmpf);
 
 	if (g->nan) return NAN;
-	mpf_init2(tmpf, PBITS);
 	inf = midpoint(tmpf, g);
 	/* TODO: round? */
 	if (inf < 0) rop = -INFINITY;
 	else if (inf > 0) rop = INFINITY;
 	else rop = mpf_get_d(tmpf);
-	mpf_clear(tmpf);
 	return(rop);
 }
 
 mpf_s *g2f(mpf_s *f, const gbnd_s *g)
 {
 	int inf;
-	mpf_t negmaxreal;
 
 	if (g->nan) {mpf_set_ui(f, 0); return f;}
-	mpf_init2(negmaxreal, PBITS);
 	inf = midpoint(f, g);
 	/* TODO: round? */
-	mpf_neg(negmaxreal, maxreal);
 	if (inf < 0 || mpf_cmp(f, negmaxreal) < 0) {
 		mpf_set(f, negmaxreal);
 	} else if (inf > 0 || mpf_cmp(f, maxreal) > 0) {
 		mpf_set(f, maxreal);
 	}
-	mpf_clear(negmaxreal);
 	return(f);
 }
 
@@ -210,29 +201,25 @@ mpf_s *g2f(mpf_s *f, const gbnd_s *g)
 
 unum_s *si2un(unum_s *un, signed long si)
 {
-	mpf_t tmpf;
+	MPF_VAR(tmpf);
 
-	mpf_init2(tmpf, sizeof(si)*8);
 	mpf_set_si(tmpf, si);
 	F2U(un, tmpf);
-	mpf_clear(tmpf);
 	return un;
 }
 
 unum_s *ui2un(unum_s *un, unsigned long ui)
 {
-	mpf_t tmpf;
+	MPF_VAR(tmpf);
 
-	mpf_init2(tmpf, sizeof(ui)*8);
 	mpf_set_ui(tmpf, ui);
 	F2U(un, tmpf);
-	mpf_clear(tmpf);
 	return un;
 }
 
 unum_s *d2un(unum_s *un, double d)
 {
-	mpf_t tmpf;
+	MPF_VAR(tmpf);
 
 	if (isnan(d)) {
 		mpx_set(un, qNaNu); /* TODO: handle sNaN? */
@@ -242,46 +229,38 @@ unum_s *d2un(unum_s *un, double d)
 		mpx_set(un, (d < 0.0) ? neginfu : posinfu);
 		return un;
 	}
-	mpf_init2(tmpf, 53);
 	mpf_set_d(tmpf, d);
 	F2U(un, tmpf);
-	mpf_clear(tmpf);
 	return un;
 }
 
 signed long un2si(const unum_s *un)
 {
 	signed long rop;
-	gbnd_t gb;
+	GB_VAR(gb);
 
-	gbnd_init(gb);
-	unum2g(gb, un);
-	rop = g2si(gb);
-	gbnd_clear(gb);
+	unum2g(&gb, un);
+	rop = g2si(&gb);
 	return(rop);
 }
 
 unsigned long un2ui(const unum_s *un)
 {
 	unsigned long rop;
-	gbnd_t gb;
+	GB_VAR(gb);
 
-	gbnd_init(gb);
-	unum2g(gb, un);
-	rop = g2ui(gb);
-	gbnd_clear(gb);
+	unum2g(&gb, un);
+	rop = g2ui(&gb);
 	return(rop);
 }
 
 double un2d(const unum_s *un)
 {
 	double rop;
-	gbnd_t gb;
+	GB_VAR(gb);
 
-	gbnd_init(gb);
-	unum2g(gb, un);
-	rop = g2d(gb);
-	gbnd_clear(gb);
+	unum2g(&gb, un);
+	rop = g2d(&gb);
 	return(rop);
 }
 
@@ -289,29 +268,25 @@ double un2d(const unum_s *un)
 
 ubnd_s *si2ub(ubnd_s *ub, signed long si)
 {
-	mpf_t tmpf;
+	MPF_VAR(tmpf);
 
-	mpf_init2(tmpf, sizeof(si)*8);
 	mpf_set_si(tmpf, si);
 	F2U(ub->l, tmpf); ub->p = 0;
-	mpf_clear(tmpf);
 	return ub;
 }
 
 ubnd_s *ui2ub(ubnd_s *ub, unsigned long ui)
 {
-	mpf_t tmpf;
+	MPF_VAR(tmpf);
 
-	mpf_init2(tmpf, sizeof(ui)*8);
 	mpf_set_ui(tmpf, ui);
 	F2U(ub->l, tmpf); ub->p = 0;
-	mpf_clear(tmpf);
 	return ub;
 }
 
 ubnd_s *d2ub(ubnd_s *ub, double d)
 {
-	mpf_t tmpf;
+	MPF_VAR(tmpf);
 
 	if (isnan(d)) {
 		ub->p = 0;
@@ -323,46 +298,38 @@ ubnd_s *d2ub(ubnd_s *ub, double d)
 		mpx_set(ub->l, (d < 0.0) ? neginfu : posinfu);
 		return ub;
 	}
-	mpf_init2(tmpf, 53);
 	mpf_set_d(tmpf, d);
 	F2U(ub->l, tmpf); ub->p = 0;
-	mpf_clear(tmpf);
 	return ub;
 }
 
 signed long ub2si(const ubnd_s *ub)
 {
 	signed long rop;
-	gbnd_t gb;
+	GB_VAR(gb);
 
-	gbnd_init(gb);
-	u2g(gb, ub);
-	rop = g2si(gb);
-	gbnd_clear(gb);
+	u2g(&gb, ub);
+	rop = g2si(&gb);
 	return(rop);
 }
 
 unsigned long ub2ui(const ubnd_s *ub)
 {
 	unsigned long rop;
-	gbnd_t gb;
+	GB_VAR(gb);
 
-	gbnd_init(gb);
-	u2g(gb, ub);
-	rop = g2ui(gb);
-	gbnd_clear(gb);
+	u2g(&gb, ub);
+	rop = g2ui(&gb);
 	return(rop);
 }
 
 double ub2d(const ubnd_s *ub)
 {
 	double rop;
-	gbnd_t gb;
+	GB_VAR(gb);
 
-	gbnd_init(gb);
-	u2g(gb, ub);
-	rop = g2d(gb);
-	gbnd_clear(gb);
+	u2g(&gb, ub);
+	rop = g2d(&gb);
 	return(rop);
 }
 
@@ -371,223 +338,212 @@ double ub2d(const ubnd_s *ub)
 /* Convert an exact unum to its [internal] float value. */
 /* Ignores ubit */
 /* Proto difference: does not handle infinity. */
+/* The significand is decoded into fsize/GMP_NUMB_BITS+2 limbs taken from
+   the unum's own utag and stored in f as it is, so the work follows the
+   operand, not PLIMBS. The value is exact unless f is shorter than it. */
 
 void u2f(mpf_s *f, const unum_s *u)
 {
-	long bias, expo, expovalue;
-	int sign;
+	mp_limb_t m[MAX_FSIZE/GMP_NUMB_BITS+2];
+	mp_limb_t expo;
+	mp_size_t n, lo, q;
+	long s;
+	unsigned int sh;
 	utag_s ut;
-	MPX_VAR(tmp);
 
 	/* ubit, exponent size, fraction size */
 	utag(&ut, u);
+	n = ut.fsize / GMP_NUMB_BITS + 1;
+	getbitsu(&expo, 1, u, ut.fsize + utagsize, ut.esize);
+	getbitsu(m, n, u, utagsize, ut.fsize);
+
+	/* value is m * 2^s, with the hidden bit when normal */
+	s = 1 - ((1L << (ut.esize-1)) - 1) - (long)ut.fsize;
+	if (expo) {
+		m[ut.fsize / GMP_NUMB_BITS] |= (mp_limb_t)1 << (ut.fsize % GMP_NUMB_BITS);
+		s += (long)expo - 1;
+	}
+
+	/* align s to a limb boundary, q limbs */
+	q = (s >= 0) ? s / GMP_NUMB_BITS : -((-s + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS);
+	sh = s - (long)q * GMP_NUMB_BITS;
+	m[n] = (sh) ? mpn_lshift(m, m, n, sh) : 0;
+	n++;
+	while (n && !m[n-1]) n--;
+	if (!n) {mpf_set_ui(f, 0); return;}
+	for (lo = 0; !m[lo]; lo++) ;
+	if (n - lo > f->_mp_prec + 1) lo = n - (f->_mp_prec + 1);
+	mpn_copyi(f->_mp_d, m + lo, n - lo);
+	f->_mp_exp = q + n;
+	f->_mp_size = n - lo;
 
-	/* exponent bias */
-	bias = (1UL << (ut.esize-1)) - 1;
+	/* sign */
+	if (mpx_tstbit(u, ut.esize + ut.fsize + utagsize)) mpf_neg(f, f);
+}
 
-	/* exponent mask */
-	mpx_set_ui(tmp, (1UL << ut.esize) - 1);
-	mpx_lshift(tmp, tmp, ut.fsize + utagsize);
+/* Conversion of an [internal] floatable real to a unum. */
+/* Most of the complexity stems from seeking the shortest possible bit string. */
+/* Proto difference: does not handle exceptional nonnumeric values. */
+/* See x2u in prototype */
 
-	/* exponent */
-	mpx_and(tmp, u, tmp);
-	mpx_rshift(tmp, tmp, ut.fsize + utagsize);
-	expo = mpx_get_ui(tmp);
+void f2u(unum_s *u, const mpf_s *f)
+{
+	mp_size_t n = __GMP_ABS(f->_mp_size);
 
-	expovalue = expo - bias + ((expo) ? 0 : 1);
+	mpn2u(u, f->_mp_size < 0, f->_mp_d, n, (long)(f->_mp_exp - n) * GMP_NUMB_BITS);
+}
 
-	/* sign */
-	sign = mpx_tstbit(u, ut.esize + ut.fsize + utagsize);
+/* Place {t,n} * 2^s into r[0..rn-1], truncating the bits below 2^0. */
 
-	/* fraction mask */
-	mpx_lshift(tmp, one, ut.fsize);
-	mpx_sub_ui(tmp, tmp, 1);
-	mpx_lshift(tmp, tmp, utagsize);
+static void putbits(mp_limb_t *r, mp_size_t rn, const mp_limb_t *t, mp_size_t n, long s)
+{
+	mp_size_t q, k;
+	unsigned int sh;
+
+	mpn_zero(r, rn);
+	if (s >= 0) {
+		q = s / GMP_NUMB_BITS;
+		sh = s % GMP_NUMB_BITS;
+		if ((k = rn - q) > n) k = n;
+		if (k <= 0) return;
+		if (sh) {
+			mp_limb_t c = mpn_lshift(r + q, t, k, sh);
+			if (q + k < rn) r[q + k] = c;
+		} else mpn_copyi(r + q, t, k);
+	} else {
+		q = -s / GMP_NUMB_BITS;
+		sh = -s % GMP_NUMB_BITS;
+		if ((k = n - q) > rn) k = rn;
+		if (k <= 0) return;
+		if (sh) {
+			mpn_rshift(r, t + q, k, sh);
+			if (q + k < n) r[k - 1] |= t[q + k] << (GMP_NUMB_BITS - sh);
+		} else mpn_copyi(r, t + q, k);
+	}
+}
 
-	/* fraction */
-	mpx_and(tmp, u, tmp);
-	mpx_rshift(tmp, tmp, utagsize);
+/* OR the bits of v into r starting at bit pos. */
 
-	mpf_set_x(f, tmp);
-	mpf_div_2exp(f, f, ut.fsize);
-	if (expo) mpf_add_ui(f, f, 1);
-	if (expovalue >= 0) mpf_mul_2exp(f, f, expovalue);
-	else mpf_div_2exp(f, f, -expovalue);
+static void setbits(mp_limb_t *r, mp_bitcnt_t pos, mp_limb_t v)
+{
+	unsigned int sh = pos % GMP_NUMB_BITS;
 
-	if (sign) mpf_neg(f, f);
+	r[pos / GMP_NUMB_BITS] |= v << sh;
+	if (sh && (v >> (GMP_NUMB_BITS - sh))) r[pos / GMP_NUMB_BITS + 1] |= v >> (GMP_NUMB_BITS - sh);
 }
 
-/* Conversion of an [internal] floatable real to a unum. */
-/* Most of the complexity stems from seeking the shortest possible bit string. */
-/* Proto difference: does not handle exceptional nonnumeric values. */
-/* See x2u in prototype */
+/* Convert (-1)^neg * {m,n} * 2^e to a unum. Follows f2u() case by case
+   on the limbs: the trailing zero count and the leading bit position
+   give the fraction length directly. */
 
-void f2u(unum_s *u, const mpf_s *f)
+void mpn2u(unum_s *u, int neg, const mp_limb_t *m, mp_size_t n, long e)
 {
+	long bias = (1L << (esizemax-1)) - 1;
+	mp_limb_t r[MAX_ULIMBS];
+	long tz, bl, sf;
 	int fs;
-	long sf;
-	mpf_t absf;
-	mpf_t tmp1;
-	mpf_t tmp2;
 
 	/* Zero is a special case. The smallest unum for it is just 0: */
-	if (mpf_sgn(f) == 0) {
+	while (n > 0 && m[n-1] == 0) n--;
+	if (n == 0) {
 		mpx_set_ui(u, 0);
 		return;
 	}
-	mpf_init2(absf, mpf_get_prec(f));
-	mpf_abs(absf, f);
+	/* Significant bits, after stripping trailing zero bits */
+	tz = mpn_scan1(m, 0);
+	bl = mpn_sizeinbase(m, n, 2) - tz;
+	e += tz;
+	sf = e + bl - 1;
 	/* Magnitudes too large to represent: */
-	if (mpf_cmp(absf, maxreal) > 0) {
-		mpx_ior(u, maxrealu, ubitmask);
-		if (mpf_sgn(f) < 0) mpx_ior(u, u, signbigu);
-		mpf_clear(absf);
-		return;
+	if (sf > bias+1 || (sf == bias+1 && bl > fsizemax)) {
+		int big = sf > bias+1;
+		if (!big) {
+			/* above maxreal if the leading fsizemax bits are all ones */
+			mp_bitcnt_t pos = tz + bl - fsizemax;
+			mp_limb_t lo = m[pos / GMP_NUMB_BITS] & (((mp_limb_t)1 << (pos % GMP_NUMB_BITS)) - 1);
+			mp_bitcnt_t below = mpn_popcount(&lo, 1);
+			if (pos / GMP_NUMB_BITS) below += mpn_popcount(m, pos / GMP_NUMB_BITS);
+			big = mpn_popcount(m, n) - below == (mp_bitcnt_t)fsizemax;
+		}
+		if (big) {
+			mpx_ior(u, maxrealu, ubitmask);
+			if (neg) mpx_ior(u, u, signbigu);
+			return;
+		}
 	}
 	/* Magnitudes too small to represent become "inexact zero"
 	   with the maximum exponent and fraction field sizes: */
-	if (mpf_cmp(absf, smallsubnormal) < 0) {
+	if (sf < 1 - bias - fsizemax) {
 		mpx_set(u, utagmask);
-		if (mpf_sgn(f) < 0) mpx_ior(u, u, signbigu);
-		mpf_clear(absf);
+		if (neg) mpx_ior(u, u, signbigu);
 		return;
 	}
-	/* For subnormal numbers, divide by the ULP value to get the
-	   fractional part. The While loop strips off trailing bits. */
-	mpf_init2(tmp1, PBITS);
-	mpf_init2(tmp2, PBITS);
-	u2f(tmp1, smallnormalu);
-	if (mpf_cmp(absf, tmp1) < 0) {
-		unsigned long efbits = mpx_get_ui(efsizemask);
-		unsigned long spos = maxubits-1;
-		int ubit;
-		mpf_div(tmp1, absf, smallsubnormal);
-		mpf_trunc(tmp2, tmp1);
-		mpx_set_f(u, tmp2); /* fractional part */
-		ubit = mpf_cmp(tmp1, tmp2) != 0;
-		if (!ubit) {
-			while (!mpx_tstbit(u, 0)) {
-				mpx_rshift(u, u, 1); /* strip trailing zero bits */
-				efbits--;
-				spos--;
-			}
+	/* Subnormal numbers, in units of the smallest subnormal */
+	if (sf < 1 - bias) {
+		mp_limb_t efbits = mpx_get_ui(efsizemask);
+		long spos = maxubits-1;
+		long s = e - (1 - bias - fsizemax);
+		if (s >= 0) {
+			/* trailing zero bits already stripped */
+			efbits -= s;
+			spos -= s;
+			putbits(r, NLIMBS, m, n, utagsize - tz);
+		} else {
+			putbits(r, NLIMBS, m, n, s - tz);
+			mpn_lshift(r, r, NLIMBS, utagsize);
+			efbits |= (mp_limb_t)1 << (utagsize-1);
 		}
-		mpx_lshift(u, u, utagsize);
-		mpx_add_ui(u, u, efbits);
-		if (ubit) mpx_ior(u, u, ubitmask);
-		if (mpf_sgn(f) < 0) mpx_setbit(u, spos);
-		mpf_clear(tmp2);
-		mpf_clear(tmp1);
-		mpf_clear(absf);
+		r[0] |= efbits;
+		if (neg) setbits(r, spos, 1);
+		mpx_set_n(u, r, NLIMBS);
 		return;
 	}
-	/* All remaining cases are in the normalized range. */
-	fs = 0;
-	if ((sf = scale(f)) >= 0) mpf_div_2exp(tmp1, absf, sf);
-	else mpf_mul_2exp(tmp1, absf, -sf);
 	/* If a number is more concise as a subnormal, make it one. */
-	if (mpf_cmp_ui(tmp1, 1) == 0 && sf <= 0) {
-		int es; /* exponent size */
-		int pc; /* population count */
+	if (bl == 1 && sf <= 0) {
+		int es, pc;
 		long tmp;
 		for (es = pc = 0, tmp = 1-sf; tmp; tmp >>= 1, es++) if (tmp & 1) pc++;
 		if (pc == 1) {
-			mpx_set_ui(u, es-1);
-			mpx_lshift(u, u, fsizesize);
-			mpx_ior(u, u, ulpu);
-			if (mpf_sgn(f) < 0) mpx_setbit(u, es+1+utagsize);
-			mpf_clear(tmp2);
-			mpf_clear(tmp1);
-			mpf_clear(absf);
+			mpx_set_ui(u, ((unsigned long)(es-1) << fsizesize) | (1UL << utagsize));
+			if (neg) mpx_setbit(u, es+1+utagsize);
 			return;
 		}
 	}
-	mpf_trunc(tmp2, tmp1);
-	while (mpf_cmp(tmp1, tmp2) != 0 && fs < fsizemax) { /* TODO: optimize */
-		fs++;
-		mpf_mul_2exp(tmp1, tmp1, 1);
-		mpf_trunc(tmp2, tmp1);
-	}
-	if (mpf_cmp(tmp1, tmp2) == 0) {
-		int nef = ne(f);
-		MPX_VAR(tmpu);
-		/* The value is representable exactly. Fill in fields from right to left: */
-		/* Size of fraction field, fits in the rightmost fsizesize bits. */
-		mpx_set_ui(u, fs - ((fs > 0) ? 1 : 0));
-		/* Size of exponent field minus 1, fits in the esizesize bits. */
-		mpx_set_ui(tmpu, ne(f) - 1);
-		mpx_lshift(tmpu, tmpu, fsizesize);
-		mpx_ior(u, u, tmpu);
-		/* Significant bits after hidden bit, fits left of the unum tag bits. */
+	fs = bl - 1;
+	if (fs <= fsizemax) {
+		/* The value is representable exactly. */
+		int nef = nesf(sf);
+		int fb = (fs > 0) ? fs : 1;
 		if (fs > 0) {
-			/* follows prototype, TODO: make more efficient */
-			long s1 = scale(tmp1);
-			mpf_set_ui(tmp1, 1);
-			mpf_mul_2exp(tmp1, tmp1, s1); /* 2^scale(tmp1) */
-			mpf_sub(tmp2, tmp2, tmp1);
-			mpx_set_f(tmpu, tmp2);
-			mpx_lshift(tmpu, tmpu, utagsize);
-			mpx_ior(u, u, tmpu);
-		}
-		/* Value of exponent bits, adjusted for bias. */
-		mpx_set_ui(tmpu, sf + (1 << (nef-1)) - 1);
-		mpx_lshift(tmpu, tmpu, utagsize + fs + ((fs == 0) ? 1 : 0));
-		mpx_ior(u, u, tmpu);
-		/* If negative, add the sign bit. */
-		if (mpf_sgn(f) < 0) {
-			mpx_set_ui(tmpu, 1);
-			mpx_lshift(tmpu, tmpu, utagsize + fs + ((fs == 0) ? 1 : 0) + nef);
-			mpx_ior(u, u, tmpu);
-		}
+			putbits(r, NLIMBS, m, n, utagsize - tz);
+			r[(utagsize + fs) / GMP_NUMB_BITS] ^= (mp_limb_t)1 << ((utagsize + fs) % GMP_NUMB_BITS);
+		} else mpn_zero(r, NLIMBS);
+		r[0] |= (fs - ((fs > 0) ? 1 : 0)) | ((mp_limb_t)(nef-1) << fsizesize);
+		setbits(r, utagsize + fb, sf + (1L << (nef-1)) - 1);
+		if (neg) setbits(r, utagsize + fb + nef, 1);
 	} else {
-		long s1, sff;
-		int nef, ne1, ne2;
-		MPX_VAR(tmpu);
-		/* Inexact. Use all available fraction bits. */
-		if ((sff = sf-fsizemax) >= 0) mpf_div_2exp(tmp1, absf, sff);
-		else mpf_mul_2exp(tmp1, absf, -sff);
-		mpf_ceil(tmp1, tmp1);
-		if (sff >= 0) mpf_mul_2exp(tmp1, tmp1, sff);
-		else mpf_div_2exp(tmp1, tmp1, -sff);
-		nef = ne(f);
-		ne1 = ne(tmp1);
-		ne2 = (nef > ne1) ? nef : ne1;
-		/* All bits on for the fraction size, since we're using the maximum. */
-		mpx_set(u, fsizemask);
-		/* Store the exponent size minus 1 in the exponent size field. */
-		mpx_set_ui(tmpu, ne2 - 1);
-		mpx_lshift(tmpu, tmpu, fsizesize);
-		mpx_ior(u, u, tmpu);
-		/* Make it inexact. */
-		mpx_ior(u, u, ubitmask);
-		/* Fraction bits are the ones to the left of the binary
-		   point after removing hidden bit and scaling. */
-		if ((s1 = scale(tmp1)) >= 0) mpf_div_2exp(tmp2, tmp1, s1);
-		else mpf_mul_2exp(tmp2, tmp1, -s1);
-		mpf_sub_ui(tmp2, tmp2, 1); /* remove hidden bit */
-		mpf_mul_2exp(tmp2, tmp2, fsizemax);
-		mpf_trunc(tmp2, tmp2);
-		mpx_set_f(tmpu, tmp2);
-		mpx_lshift(tmpu, tmpu, utagsize);
-		mpx_ior(u, u, tmpu);
-		/* Exponent value goes in the exponent field. */
-		mpx_set_ui(tmpu, s1 + (1 << (ne2-1)) - 1);
-		mpx_lshift(tmpu, tmpu, utagsize + fsizemax);
-		mpx_ior(u, u, tmpu);
-		/* Back off by one ULP. */
-		/* If frac is zero, this will borrow from exponent. */
-		mpx_sub(u, u, ulpu);
-		/* If negative, set the sign bit in the unum. */
-		if (mpf_sgn(f) < 0) {
-			mpx_set_ui(tmpu, 1);
-			mpx_lshift(tmpu, tmpu, utagsize + fsizemax + ne2);
-			mpx_ior(u, u, tmpu);
+		/* Inexact. Round the magnitude up to a full fraction and back off one ULP. */
+		mp_limb_t c[MAX_FSIZE/GMP_NUMB_BITS+2];
+		mp_size_t cn = (fsizemax+1) / GMP_NUMB_BITS + 1;
+		long s1 = sf;
+		int ne2;
+		putbits(c, cn, m, n, fsizemax - fs - tz);
+		mpn_add_1(c, c, cn, 1);
+		if (mpn_sizeinbase(c, cn, 2) > (size_t)fsizemax+1) {
+			mpn_rshift(c, c, cn, 1);
+			s1++;
 		}
+		ne2 = nesf(sf);
+		if (nesf(s1) > ne2) ne2 = nesf(s1);
+		c[fsizemax / GMP_NUMB_BITS] ^= (mp_limb_t)1 << (fsizemax % GMP_NUMB_BITS); /* hidden bit */
+		putbits(r, NLIMBS, c, cn, utagsize);
+		r[0] |= mpx_get_ui(fsizemask) | ((mp_limb_t)(ne2-1) << fsizesize) | ((mp_limb_t)1 << (utagsize-1));
+		setbits(r, utagsize + fsizemax, s1 + (1L << (ne2-1)) - 1);
+		/* If frac is zero, this will borrow from exponent. */
+		mpn_sub_1(r, r, NLIMBS, (mp_limb_t)1 << utagsize);
+		if (neg) setbits(r, utagsize + fsizemax + ne2, 1);
 	}
-	mpf_clear(tmp2);
-	mpf_clear(tmp1);
-	mpf_clear(absf);
-	return;
+	mpx_set_n(u, r, NLIMBS);
 }
 
 /* Conversion of a unum to a general interval. */
@@ -664,7 +620,8 @@ void unum2g(gbnd_s *a, const unum_s *u)
 
 void ubnd2g(gbnd_s *a, const ubnd_s *ub)
 {
-	gbnd_s gL, gR;
+	GB_VAR(gL);
+	GB_VAR(gR);
 
 	if (nanuQ(ub->l) || nanuQ(ub->r)) {
 		a->nan = 1;
@@ -675,8 +632,6 @@ void ubnd2g(gbnd_s *a, const ubnd_s *ub)
 		return;
 	}
 
-	gbnd_init(&gL);
-	gbnd_init(&gR);
 	a->nan = 0;
 
 	unum2g(&gL, ub->l);
@@ -688,9 +643,6 @@ void ubnd2g(gbnd_s *a, const ubnd_s *ub)
 	mpf_set(a->r.f, gR.r.f);
 	a->r.inf  = gR.r.inf;
 	a->r.open = gR.r.open;
-
-	gbnd_clear(&gL);
-	gbnd_clear(&gR);
 }
 
 /* Conversion of a unum or ubound to a general interval. */
@@ -703,6 +655,8 @@ void u2g(gbnd_s *a, const ubnd_s *ub)
 //printf("u2g(a): "); print_gb(a); putchar('\n');
 }
 
+static void g2ut(ubnd_s *a, const gbnd_s *g, int unif);
+
 /* Seek a single-ULP enclosure for a ubound >= zero. */
 /* unifypos is only called by unify which screens for NaN & Inf */
 
@@ -715,7 +669,9 @@ static void unifypos(ubnd_s *a, const ubnd_s *ub)
 	MPX_VAR(uv);
 	MPX_VAR(uw);
 	MPX_VAR(ux);
-	gbnd_s gu, gv, gn, gb;
+	GB_VAR(gu);
+	GB_VAR(gv);
+	GB_VAR(gb);
 
 // printf(" unifypos:"); print_ub(ub); putchar('\n');
 	u = ub->l;
@@ -732,9 +688,6 @@ static void unifypos(ubnd_s *a, const ubnd_s *ub)
 	}
 #endif
 
-	gbnd_init(&gu);
-	gbnd_init(&gv);
-
 // printf(" trivial:"); putchar('\n');
 	/* Trivial case where endpoints express the same value. */
 	/* TODO: make more efficient */
@@ -742,29 +695,20 @@ static void unifypos(ubnd_s *a, const ubnd_s *ub)
 	unum2g(&gv, v);
 	if (samegQ(&gu, &gv)) {
 		/* NOTE: call to g2u has recursion potential */
-		g2u(a, &gu);
-		gbnd_clear(&gv);
-		gbnd_clear(&gu);
+		g2ut(a, &gu, 1); /* unify here even if deferred */
 		return;
 	}
 
 // printf(" low:"); putchar('\n');
 	/* Cannot unify if the interval includes exact 0, 1, 2, or 3. */
-	gbnd_init(&gn);
-	gbnd_init(&gb);
 	u2g(&gb, ub);
-	if (nneqgQ(&gb,ui2g(&gn,0)) || nneqgQ(&gb,ui2g(&gn,1)) ||
-		nneqgQ(&gb,ui2g(&gn,2)) || nneqgQ(&gb,ui2g(&gn,3))) {
+	if (nneqgQ(&gb,zerog) || nneqgQ(&gb,oneg) ||
+		nneqgQ(&gb,twog) || nneqgQ(&gb,threeg)) {
 		a->p = ub->p;
 		mpx_set(a->l, ub->l);
 		mpx_set(a->r, ub->r);
-		gbnd_clear(&gb);
-		gbnd_clear(&gn);
-		gbnd_clear(&gv);
-		gbnd_clear(&gu);
 		return;
 	}
-	gbnd_clear(&gb);
 
 	/* Refine the endpoints for the tightest possible unification. */
 	if (gu.l.inf) {
@@ -786,9 +730,6 @@ static void unifypos(ubnd_s *a, const ubnd_s *ub)
 		a->p = 0;
 		mpx_set(a->l, uu);
 		mpx_set(a->r, uu);
-		gbnd_clear(&gn);
-		gbnd_clear(&gv);
-		gbnd_clear(&gu);
 		return;
 	}
 
@@ -798,8 +739,7 @@ static void unifypos(ubnd_s *a, const ubnd_s *ub)
 	   special handling is needed. */
 	if (gv.r.inf && mpf_sgn(gv.r.f) > 0 && gv.r.open) {
 		unum2g(&gu, uu);
-		unum2g(&gn, maxrealu);
-		if (ltgQ(&gn, &gu)) {
+		if (ltgQ(maxrealg, &gu)) {
 			a->p = 0;
 			mpx_set(a->l, maxrealu);
 			mpx_ior(a->l, a->l, ubitmask);
@@ -816,9 +756,6 @@ static void unifypos(ubnd_s *a, const ubnd_s *ub)
 			mpx_set(a->l, uu);
 			mpx_set(a->r, uu);
 		}
-		gbnd_clear(&gn);
-		gbnd_clear(&gv);
-		gbnd_clear(&gu);
 		return;
 	}
 
@@ -870,12 +807,12 @@ static void unifypos(ubnd_s *a, const ubnd_s *ub)
 	if (mpx_cmp(uu, uv) != 0 &&
 		mpx_zero_p(uw) &&
 		mpx_tstbit(uu, utagsize-1) &&
-		ltgQ(&gv, ui2g(&gn,1)))
+		ltgQ(&gv, oneg))
 	{
 		int n;
 		long exp;
 		double frac;
-		mpf_t tmpf;
+		MPF_VAR(tmpf);
 		if (exQ(uv)) mpx_add(ux, uv, ubitmask);
 		else mpx_set(ux, uv);
 		unum2g(&gv, ux);
@@ -892,16 +829,11 @@ static void unifypos(ubnd_s *a, const ubnd_s *ub)
 		n--;
 		if (esizemax < n) n = esizemax;
 		a->p = 0;
-		mpf_init2(tmpf, 1); /* only needs one bit of precision */
 		mpf_set_ui(tmpf, 1);
 		mpf_div_2exp(tmpf, tmpf, (1UL << n)-1);
 		f2u(a->l, tmpf);
 		mpx_sub(a->l, a->l, ubitmask);
 		mpx_set(a->r, a->l);
-		mpf_clear(tmpf);
-		gbnd_clear(&gn);
-		gbnd_clear(&gv);
-		gbnd_clear(&gu);
 		return;
 	}
 
@@ -915,10 +847,6 @@ static void unifypos(ubnd_s *a, const ubnd_s *ub)
 		mpx_set(a->r, ub->r);
 	}
 // printf(" finish: "); print_ub(a); putchar('\n');
-
-	gbnd_clear(&gn);
-	gbnd_clear(&gv);
-	gbnd_clear(&gu);
 }
 
 /* Seek a single-ULP enclosure for a ubound. */
@@ -935,7 +863,8 @@ void unify(ubnd_s *a, const ubnd_s *ub)
 	ubnd_s ubb = {1, u3, u4};
 	unum_s *u;
 	unum_s *v;
-	gbnd_s gu, gv, zero;
+	GB_VAR(gu);
+	GB_VAR(gv);
 
 	u = ub->l;
 	v = (ub->p) ? ub->r : ub->l;
@@ -962,34 +891,22 @@ void unify(ubnd_s *a, const ubnd_s *ub)
 // printf(" -Inf "); fflush(stdout);
 		return;
 	}
-	gbnd_init(&gu);
-	gbnd_init(&gv);
-	gbnd_init(&zero);
 	unum2g(&gu, u);
 	unum2g(&gv, v);
-	ui2g(&zero, 0);
 	/* Skip trivial cases that cannot be unified. */
 	/* NOTE: when called by g2u(), any NaN cases will be handled beforehand. */
-	if (infuQ(u) || infuQ(v) || (ltgQ(&gu,&zero) && !ltgQ(&gv,&zero))) {
+	if (infuQ(u) || infuQ(v) || (ltgQ(&gu,zerog) && !ltgQ(&gv,zerog))) {
 		a->p = ub->p;
 		mpx_set(a->l, ub->l);
 		mpx_set(a->r, ub->r);
-		gbnd_clear(&gu);
-		gbnd_clear(&gv);
-		gbnd_clear(&zero);
 // printf(" +-Inf_Intersect0 "); fflush(stdout);
 		return;
 	}
-	if (ltgQ(&gu,&zero) && ltgQ(&gv,&zero)) {
+	if (ltgQ(&gu,zerog) && ltgQ(&gv,zerog)) {
 		/* TODO: add a neg_un(unum_s *, const unum_s *) to ulayer or support. */
-		/* ubnd.h not included here */
-		void negateu(ubnd_s *a, const ubnd_s *u);
 		negateu(&uba, ub);
 		unifypos(&ubb, &uba);
 		negateu(a, &ubb);
-		gbnd_clear(&gu);
-		gbnd_clear(&gv);
-		gbnd_clear(&zero);
 // printf(" NegUnify "); fflush(stdout);
 		return;
 	}
@@ -999,18 +916,12 @@ void unify(ubnd_s *a, const ubnd_s *ub)
 		a->p = 0;
 		mpx_set(a->l, tu);
 		mpx_set(a->r, tu);
-		gbnd_clear(&gu);
-		gbnd_clear(&gv);
-		gbnd_clear(&zero);
 // printf(" Same "); fflush(stdout);
 		return;
 	}
 	unifypos(a, ub);
 
 // printf(" PosUnify "); print_ub(a); fflush(stdout);
-	gbnd_clear(&gu);
-	gbnd_clear(&gv);
-	gbnd_clear(&zero);
 }
 
 #if 0
@@ -1023,16 +934,14 @@ void unify(ubnd_s *a, const ubnd_s *ub)
 	MPX_VAR(u3);
 	MPX_VAR(u4);
 	ubnd_s ubb = {1, u3, u4};
-	gbnd_s g;
+	GB_VAR(g);
 
-	gbnd_init(&g);
 	u2g(&g, ub);
 	/* Exception case */
 	if (g.nan) {
 		a->p = 0;
 		mpx_set(a->l, qNaNu);
 		mpx_set(a->r, qNaNu);
-		gbnd_clear(&g);
 		AOP1("NaN",a,ub,unify,ub,ub);
 		return;
 	}
@@ -1045,45 +954,36 @@ void unify(ubnd_s *a, const ubnd_s *ub)
 		unifypos(&ubb, &uba);
 		negateui(a, &ubb);
 	}
-	gbnd_clear(&g);
 }
 #endif
 
-/* Find the left half of a ubound (numerical value and open-closed bit). */
+/* Find the left half of a ubound (numerical value and open-closed bit).
+   On entry u holds f2u(gn->f); f2u() sets the ubit only when the value
+   is not exact, so the encoding itself gives the exactness test. */
 
 static void ubleft(unum_s *u, const gnum_s *gn)
 {
-	mpf_t tmpf;
-
 	if (gn->inf && mpf_sgn(gn->f) < 0) {
 		if (gn->open) mpx_set(u, negopeninfu);
 		else mpx_set(u, neginfu);
 		return;
 	}
-	mpf_init2(tmpf, PBITS);
-	/* TODO: reduce f2u calls. g2u() does one before calling ubleft(). */
-	f2u(u, gn->f);
-	u2f(tmpf, u);
-	/* TODO: A less expensive test that doesn't require f2u -> u2f is needed. */
-	if (mpf_cmp(tmpf, gn->f) == 0) {
+	if (exQ(u)) {
 		if (gn->open) {
 			if (mpf_sgn(gn->f) < 0) mpx_sub(u, u, ulpu);
 			mpx_ior(u, u, ubitmask);
 		}
-		mpf_clear(tmpf);
 		return;
 	}
 	if (gn->open) mpx_ior(u, u, ubitmask);
-	mpf_clear(tmpf);
 }
 
 /* Find the right half of a ubound (numerical value and open-closed bit).
-   Not exactly the reverse of ubleft, because of "negative zero". */
+   Not exactly the reverse of ubleft, because of "negative zero".
+   On entry u holds f2u(gn->f), as for ubleft. */
 
 static void ubright(unum_s *u, const gnum_s *gn)
 {
-	mpf_t tmpf;
-
 	if (gn->inf && mpf_sgn(gn->f) > 0) {
 		if (gn->open) mpx_set(u, posopeninfu);
 		else mpx_set(u, posinfu);
@@ -1093,26 +993,118 @@ static void ubright(unum_s *u, const gnum_s *gn)
 		mpx_set(u, negopenzerou);
 		return;
 	}
-	mpf_init2(tmpf, PBITS);
-	/* TODO: reduce f2u calls. g2u() does one before calling ubright(). */
-	f2u(u, gn->f);
-	u2f(tmpf, u);
-	/* TODO: A less expensive test that doesn't require f2u -> u2f is needed. */
-	if (mpf_cmp(tmpf, gn->f) == 0) {
+	if (exQ(u)) {
 		if (gn->open) {
 			if (mpf_sgn(gn->f) >= 0) mpx_sub(u, u, ulpu);
 			mpx_ior(u, u, ubitmask);
 		}
-		mpf_clear(tmpf);
 		return;
 	}
 	if (gn->open) mpx_ior(u, u, ubitmask);
-	mpf_clear(tmpf);
 }
 
-/* Convert a general interval to the closest possible ubound. */
+/* Unify ub only if the single unum holds the same set, as g2u does.
+   a may be ub. */
 
-void g2u(ubnd_s *a, const gbnd_s *g)
+void unifyeq(ubnd_s *a, const ubnd_s *ub)
+{
+	MPX_VAR(u1);
+	MPX_VAR(u2);
+	ubnd_s t = {1, u1, u2};
+
+	if (!ub->p) {
+		if (a != ub) {a->p = 0; mpx_set(a->l, ub->l); mpx_set(a->r, ub->l);}
+		return;
+	}
+	mpx_set(t.l, ub->l);
+	mpx_set(t.r, ub->r);
+	unify(a, &t);
+	if (!sameuQ(a, &t)) {
+		a->p = 1;
+		mpx_set(a->l, t.l);
+		mpx_set(a->r, t.r);
+	}
+}
+
+/* Decide if v, the unified form of the pair ub, is worth the lost
+   accuracy. As in the book, it is if
+   (width of ub / width of v) * (bits in ub / bits in v) >= ratio,
+   taking the cases of infinite or zero width first: an infinite width
+   of v is kept only if ub had one too, and otherwise an infinite width
+   of ub or a zero width of v makes the ratio infinite. */
+
+static int smartQ(const ubnd_s *v, const ubnd_s *ub, const mpf_s *ratio)
+{
+	GB_VAR(gv);
+	GB_VAR(gb);
+	MPF_VAR(wb);
+	MPF_VAR(wv);
+
+	if (v->p) return 0; /* unify failed */
+	u2g(&gv, v);
+	u2g(&gb, ub);
+	if (gv.nan || gb.nan) return 0;
+	if (gv.l.inf || gv.r.inf) return gb.l.inf || gb.r.inf;
+	if (gb.l.inf || gb.r.inf) return 1;
+	mpf_sub(wv, gv.r.f, gv.l.f);
+	if (mpf_sgn(wv) == 0) return 1;
+	mpf_sub(wb, gb.r.f, gb.l.f);
+	mpf_mul_ui(wb, wb, nbitsu(ub));
+	mpf_mul(wv, wv, ratio);
+	mpf_mul_ui(wv, wv, nbitsu(v));
+	return mpf_cmp(wb, wv) >= 0;
+}
+
+/* Unify ub if the loss of accuracy is worth the saving in bits, see
+   smartQ. ratio 1 keeps the product of width and bits from growing,
+   a smaller ratio trades more accuracy for fewer bits. a may be ub. */
+
+void smartunify(ubnd_s *a, const ubnd_s *ub, const mpf_s *ratio)
+{
+	MPX_VAR(u1);
+	MPX_VAR(u2);
+	ubnd_s t = {1, u1, u2};
+
+	if (!ub->p) {
+		if (a != ub) {a->p = 0; mpx_set(a->l, ub->l); mpx_set(a->r, ub->l);}
+		return;
+	}
+	mpx_set(t.l, ub->l);
+	mpx_set(t.r, ub->r);
+	unify(a, &t);
+	if (!smartQ(a, &t, ratio)) {
+		a->p = 1;
+		mpx_set(a->l, t.l);
+		mpx_set(a->r, t.r);
+	}
+}
+
+/* Smart unify in g2u, per thread, see unify_smart. */
+static UNUM_TLS double smart_ratio;
+
+double unify_smart(double ratio)
+{
+	double prev = smart_ratio;
+
+	smart_ratio = ratio;
+	return prev;
+}
+
+/* Deferred unify, per thread, see unify_defer. */
+static UNUM_TLS int defer_on;
+
+int unify_defer(int on)
+{
+	int prev = defer_on;
+
+	defer_on = on;
+	return prev;
+}
+
+/* Convert a general interval to the closest possible ubound.
+   If unif is zero, a pair is returned as is instead of being unified. */
+
+static void g2ut(ubnd_s *a, const gbnd_s *g, int unif)
 {
 // printf(" g2u: "); print_gb(g);
 	/* Get rid of the NaN cases first. */
@@ -1161,24 +1153,26 @@ void g2u(ubnd_s *a, const gbnd_s *g)
 		MPX_VAR(u1);
 		MPX_VAR(u2);
 		ubnd_s ub = {1, u1, u2};
-		gbnd_s gA, gB;
-
-		gbnd_init(&gA);
-		gbnd_init(&gB);
+		int keep;
 
-		/* TODO: A less expensive test that doesn't require f2u -> u2f (again) is needed. */
+		/* Reuse the endpoint encodings from above. */
+		mpx_set(ub.l, a->l);
+		mpx_set(ub.r, a->r);
 		ubleft(ub.l, &g->l);
 		ubright(ub.r, &g->r);
+		if (!unif) {
+			mpx_set(a->l, ub.l);
+			mpx_set(a->r, ub.r);
+			return;
+		}
 		unify(a, &ub);
-		u2g(&gA, a);
-		u2g(&gB, &ub);
-		if (gA.nan != gB.nan ||
-			mpf_cmp(gA.l.f, gB.l.f) != 0 ||
-			gA.l.inf != gB.l.inf ||
-			gA.l.open != gB.l.open ||
-			mpf_cmp(gA.r.f, gB.r.f) != 0 ||
-			gA.r.inf != gB.r.inf ||
-			gA.r.open != gB.r.open)
+		keep = sameuQ(a, &ub);
+		if (!keep && smart_ratio > 0) {
+			MPF_VAR(ratio);
+			mpf_set_d(ratio, smart_ratio);
+			keep = smartQ(a, &ub, ratio);
+		}
+		if (!keep)
 		{
 			a->p = 1;
 			mpx_set(a->l, ub.l);
@@ -1187,17 +1181,28 @@ void g2u(ubnd_s *a, const gbnd_s *g)
 		}
 // printf(" [(x,y)]: "); print_ub(a); putchar('\n');
 
-		gbnd_clear(&gA);
-		gbnd_clear(&gB);
 	}
 }
 
+void g2u(ubnd_s *a, const gbnd_s *g)
+{
+	g2ut(a, g, !defer_on);
+}
+
+/* Convert a general interval to a ubound without unifying, for an
+   intermediate result. unifyeq(a, a) makes it the same as g2u(a, g). */
+
+void g2un(ubnd_s *a, const gbnd_s *g)
+{
+	g2ut(a, g, 0);
+}
+
 /* Convert a general interval to an exact ubound with rounding. */
 
 void g2ur(ubnd_s *a, const gbnd_s *g)
 {
 	int inf;
-	mpf_t tmpf;
+	MPF_VAR(tmpf);
 
 	a->p = 0;
 	/* NaN case */
@@ -1214,39 +1219,53 @@ void g2ur(ubnd_s *a, const gbnd_s *g)
 		return;
 	}
 	/* Average the endpoint values and convert to a unum. */
-	mpf_init2(tmpf, PBITS);
 	inf = midpoint(tmpf, g);
 	if (inf > 0) mpx_set(a->l, posinfu);
 	else if (inf < 0) mpx_set(a->l, neginfu);
 	else f2u(a->l, tmpf);
-	mpf_clear(tmpf);
 	roundu(a->l);
 }
 
 /* Turn a unum into a guess, for imitation of float behavior. */
 
-void guessu(unum_s *a, const ubnd_s *ub)
+static void guesst(unum_s *a, const ubnd_s *ub, gbnd_s *gb, mpf_t tmpf)
 {
 	int inf;
-	gbnd_s gb;
-	mpf_t tmpf;
 
-	gbnd_init(&gb);
-	u2g(&gb, ub);
+	u2g(gb, ub);
 	/* NaN case */
-	if (gb.nan) {
+	if (gb->nan) {
 		mpx_set(a, qNaNu);
-		gbnd_clear(&gb);
 		AOP1("NaN",a,un,guessu,ub,ub);
 		return;
 	}
 	/* Average the endpoint values and convert to a unum. */
-	mpf_init2(tmpf, PBITS);
-	inf = midpoint(tmpf, &gb);
+	inf = midpoint(tmpf, gb);
 	if (inf > 0) mpx_set(a, posinfu);
 	else if (inf < 0) mpx_set(a, neginfu);
 	else f2u(a, tmpf);
-	mpf_clear(tmpf);
-	gbnd_clear(&gb);
 	roundu(a);
 }
+
+void guessu(unum_s *a, const ubnd_s *ub)
+{
+	GB_VAR(gb);
+	MPF_VAR(tmpf);
+
+	guesst(a, ub, &gb, tmpf);
+}
+
+/* Guess each of n ubounds into the left end point of a single unum
+   ubound. */
+
+void guessu_n(ubnd_s *a, const ubnd_s *ub, size_t n)
+{
+	GB_VAR(gb);
+	MPF_VAR(tmpf);
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		guesst(a[i].l, ub+i, &gb, tmpf);
+		a[i].p = 0;
+	}
+}
@@ -69,16 +69,31 @@ double ub2d(const ubnd_s *ub);
 /*-------- other conversion --------*/
 void u2f(mpf_s *f, const unum_s *u);
 void f2u(unum_s *u, const mpf_s *f);
+void mpn2u(unum_s *u, int neg, const mp_limb_t *m, mp_size_t n, long e);
 
 void unum2g(gbnd_s *a, const unum_s *u);
 void ubnd2g(gbnd_s *a, const ubnd_s *ub);
 void u2g(gbnd_s *a, const ubnd_s *ub);
 void g2u(ubnd_s *a, const gbnd_s *g);
+void g2un(ubnd_s *a, const gbnd_s *g);
 void g2ur(ubnd_s *a, const gbnd_s *g);
 
+/* With deferred unify on, g2u leaves results that are pairs as pairs,
+   like g2un. A pair holds the same set as its unified form, only in more
+   bits; unifyeq(a, a) compacts it at a store or checkpoint. The setting is
+   per thread, off by default; unify_defer returns the previous one. */
+int unify_defer(int on);
+
+/* With a smart unify ratio above 0, g2u also unifies pairs that lose
+   accuracy when smartunify would, see conv.c. The setting is per thread,
+   0 (off) by default; unify_smart returns the previous one. */
+double unify_smart(double ratio);
+
 void unify(ubnd_s *a, const ubnd_s *ub);
+void unifyeq(ubnd_s *a, const ubnd_s *ub);
 void smartunify(ubnd_s *a, const ubnd_s *ub, const mpf_s *ratio);
 void guessu(unum_s *a, const ubnd_s *ub);
+void guessu_n(ubnd_s *a, const ubnd_s *ub, size_t n);
 
 #if defined (__cplusplus)
 }
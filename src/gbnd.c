@@ -25,10 +25,27 @@
 
 #include "gbnd.h"
 #include "hlayer.h"
+#include "uenv.h" /* PLIMBS */
+#include "gmp_macro.h" /* PREC */
 
 
 /* scratchpad */
 
+/* Precision of the temporaries of an operation, in limbs: that of its
+   widest operand or result, PLIMBS except in the fused u-layer ops. */
+
+static int widest(const gbnd_s *a, const gbnd_s *x, const gbnd_s *y)
+{
+	int n = PREC(a->l.f);
+
+	if (PREC(a->r.f) > n) n = PREC(a->r.f);
+	if (PREC(x->l.f) > n) n = PREC(x->l.f);
+	if (PREC(x->r.f) > n) n = PREC(x->r.f);
+	if (PREC(y->l.f) > n) n = PREC(y->l.f);
+	if (PREC(y->r.f) > n) n = PREC(y->r.f);
+	return n;
+}
+
 /* Test if interval g is strictly less than interval h. */
 
 int ltgQ(const gbnd_s *g, const gbnd_s *h)
@@ -134,16 +151,10 @@ void plusg(gbnd_s *a, const gbnd_s *x, const gbnd_s *y)
 		a->l.open = x->l.open || y->l.open;
 		/* NOTE: this range check is not in the Mathematica notebook 6-24-2015 */
 #if 0
-		{
-			mpf_t tmpf;
-			mpf_init2(tmpf, PBITS);
-			mpf_neg(tmpf, maxreal);
-			if (mpf_cmp(a->l.f, tmpf) < 0) {
-				mpf_set_si(a->l.f, -1); a->l.inf = 1; a->l.open = 1;
-			} else if (mpf_cmp(a->l.f, maxreal) > 0) {
-				mpf_set(a->l.f, maxreal); a->l.inf = 0; a->l.open = 1;
-			}
-			mpf_clear(tmpf);
+		if (mpf_cmp(a->l.f, negmaxreal) < 0) {
+			mpf_set_si(a->l.f, -1); a->l.inf = 1; a->l.open = 1;
+		} else if (mpf_cmp(a->l.f, maxreal) > 0) {
+			mpf_set(a->l.f, maxreal); a->l.inf = 0; a->l.open = 1;
 		}
 #endif
 	}
@@ -178,16 +189,10 @@ void plusg(gbnd_s *a, const gbnd_s *x, const gbnd_s *y)
 		a->r.open = x->r.open || y->r.open;
 		/* TODO: this range check is not in the Mathematica notebook 6-24-2015 */
 #if 0
-		{
-			mpf_t tmpf;
-			mpf_init2(tmpf, PBITS);
-			mpf_neg(tmpf, maxreal);
-			if (mpf_cmp(a->r.f, tmpf) < 0) {
-				mpf_set(a->r.f, tmpf); a->r.inf = 0; a->r.open = 1;
-			} else if (mpf_cmp(a->r.f, maxreal) > 0) {
-				mpf_set_si(a->r.f, 1); a->r.inf = 1; a->r.open = 1;
-			}
-			mpf_clear(tmpf);
+		if (mpf_cmp(a->r.f, negmaxreal) < 0) {
+			mpf_set(a->r.f, negmaxreal); a->r.inf = 0; a->r.open = 1;
+		} else if (mpf_cmp(a->r.f, maxreal) > 0) {
+			mpf_set_si(a->r.f, 1); a->r.inf = 1; a->r.open = 1;
 		}
 #endif
 	}
@@ -204,12 +209,10 @@ void plusg(gbnd_s *a, const gbnd_s *x, const gbnd_s *y)
 
 void minusg(gbnd_s *a, const gbnd_s *x, const gbnd_s *y)
 {
-	gbnd_s gb;
+	GB_VAR(gb);
 
-	gbnd_init(&gb);
 	negateg(&gb, y);
 	plusg(a, x, &gb);
-	gbnd_clear(&gb);
 }
 
 /* The "left" multiplication table for general intervals. */
@@ -272,8 +275,12 @@ static int timesposright(gnum_s *a, const gnum_s *x, const gnum_s *y)
 
 void timesg(gbnd_s *a, const gbnd_s *x, const gbnd_s *y)
 {
-	gnum_s lcan, rcan;
-	gnum_s agn, xgn, ygn;
+	int n = widest(a, x, y);
+	GN_VARN(lcan, n);
+	GN_VARN(rcan, n);
+	GN_VARN(agn, n);
+	GN_VARN(xgn, n);
+	GN_VARN(ygn, n);
 
 	/* If any value is NaN, the result is also NaN. */
 	if (x->nan || y->nan) {
@@ -286,12 +293,6 @@ void timesg(gbnd_s *a, const gbnd_s *x, const gbnd_s *y)
 	}
 	a->nan = 0;
 
-	gnum_init(&lcan);
-	gnum_init(&rcan);
-	gnum_init(&agn);
-	gnum_init(&xgn);
-	gnum_init(&ygn);
-
 	/* Lower left corner is in upper right quadrant, facing uphill: */
 	if (mpf_sgn(x->l.f) >= 0 && mpf_sgn(y->l.f) >= 0) {
 		a->nan |= timesposleft(&lcan, &x->l, &y->l);
@@ -388,11 +389,6 @@ void timesg(gbnd_s *a, const gbnd_s *x, const gbnd_s *y)
 		a->r.inf = rcan.inf;
 		a->r.open = rcan.open;
 	}
-	gnum_clear(&ygn);
-	gnum_clear(&xgn);
-	gnum_clear(&agn);
-	gnum_clear(&rcan);
-	gnum_clear(&lcan);
 }
 
 /* The "left" division table for general intervals. */
@@ -445,8 +441,12 @@ static int divideposright(gnum_s *a, const gnum_s *x, const gnum_s *y)
 
 void divideg(gbnd_s *a, const gbnd_s *x, const gbnd_s *y)
 {
-	gnum_s lcan, rcan;
-	gnum_s agn, xgn, ygn;
+	int n = widest(a, x, y);
+	GN_VARN(lcan, n);
+	GN_VARN(rcan, n);
+	GN_VARN(agn, n);
+	GN_VARN(xgn, n);
+	GN_VARN(ygn, n);
 
 	/* If any value is NaN, or denominator contains 0, the result is also NaN. */
 	if (x->nan || y->nan ||
@@ -461,12 +461,6 @@ void divideg(gbnd_s *a, const gbnd_s *x, const gbnd_s *y)
 	}
 	a->nan = 0;
 
-	gnum_init(&lcan);
-	gnum_init(&rcan);
-	gnum_init(&agn);
-	gnum_init(&xgn);
-	gnum_init(&ygn);
-
 	/* FIXME: should not need a test for (y == 0(closed)), follows prototype */
 	/* Upper left corner is in upper right quadrant, facing uphill: */
 	if (mpf_sgn(x->l.f) >= 0 &&
@@ -565,18 +559,14 @@ void divideg(gbnd_s *a, const gbnd_s *x, const gbnd_s *y)
 		a->r.inf = rcan.inf;
 		a->r.open = rcan.open;
 	}
-	gnum_clear(&ygn);
-	gnum_clear(&xgn);
-	gnum_clear(&agn);
-	gnum_clear(&rcan);
-	gnum_clear(&lcan);
 }
 
 /* Square in the g-layer. */
 
 void squareg(gbnd_s *a, const gbnd_s *g)
 {
-	gnum_s t1, t2;
+	GN_VAR(t1);
+	GN_VAR(t2);
 	gnum_s *aL, *aR;
 
 	if (g->nan) {
@@ -589,9 +579,6 @@ void squareg(gbnd_s *a, const gbnd_s *g)
 	}
 	a->nan = 0;
 
-	gnum_init(&t1);
-	gnum_init(&t2);
-
 	mpf_pow_ui(t1.f, g->l.f, 2);
 	t1.inf = g->l.inf;
 	t1.open = g->l.open;
@@ -620,9 +607,6 @@ void squareg(gbnd_s *a, const gbnd_s *g)
 	mpf_set(a->r.f, aR->f);
 	a->r.inf = aR->inf;
 	a->r.open = aR->open;
-
-	gnum_clear(&t2);
-	gnum_clear(&t1);
 }
 
 /* Square root in the g-layer. */
@@ -651,7 +635,7 @@ void sqrtg(gbnd_s *a, const gbnd_s *g)
 
 void negateg(gbnd_s *a, const gbnd_s *g)
 {
-	gnum_s tmp;
+	GN_VAR(tmp);
 	const gnum_s *gl, *gr;
 
 	/* Handle NaN input */
@@ -667,7 +651,6 @@ void negateg(gbnd_s *a, const gbnd_s *g)
 
 	/* Use temporary if input and output are the same */
 	if (a == g) {
-		gnum_init(&tmp);
 		mpf_set(tmp.f, g->l.f);
 		tmp.inf  = g->l.inf;
 		tmp.open = g->l.open;
@@ -685,15 +668,13 @@ void negateg(gbnd_s *a, const gbnd_s *g)
 	mpf_neg(a->r.f, gl->f);
 	a->r.inf  = gl->inf;
 	a->r.open = gl->open;
-
-	if (a == g) gnum_clear(&tmp);
 }
 
 /* Absolute value in the g-layer. */
 
 void absg(gbnd_s *a, const gbnd_s *g)
 {
-	gbnd_s tmp;
+	GB_VAR(tmp);
 
 	if (g->nan) {
 		a->nan = 1;
@@ -705,7 +686,6 @@ void absg(gbnd_s *a, const gbnd_s *g)
 	}
 	a->nan = 0;
 
-	gbnd_init(&tmp);
 	mpf_abs(tmp.l.f, g->l.f);
 	tmp.l.inf = g->l.inf;
 	tmp.l.open = g->l.open;
@@ -744,8 +724,6 @@ void absg(gbnd_s *a, const gbnd_s *g)
 		a->r.inf = tmp.r.inf;
 		a->r.open = tmp.r.open;
 	}
-
-	gbnd_clear(&tmp);
 }
 
 void ming(gbnd_s *a, const gbnd_s *x, const gbnd_s *y)
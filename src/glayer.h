@@ -27,6 +27,7 @@
 #define GLAYER_H_
 
 #include "gmp.h"
+#include "gmp_aux.h" /* mpf_s */
 
 /* pg 66
 Definition: The #g-layer# is the scratchpad where results are computed 
@@ -61,7 +62,7 @@ Definition: A #gbound# is the data structure used for temporary
 calculations at higher precision than in the unum environment; that is, 
 the scratchpad. 
 */
-typedef struct {
+typedef struct gbnd_s {
 	gnum_s l;
 	gnum_s r;
 	unsigned int nan : 1;
@@ -70,6 +71,29 @@ typedef gbnd_s gbnd_t[1];
 
 typedef enum {RE=0, LE=2} end_t;
 
+/* Stack-resident temporaries with PLIMBS+1 limbs, see MPF_VAR in mpx.h.
+   PLIMBS comes from uenv.h at the point of use. */
+#define GN_VAR(name) \
+	mp_limb_t _##name##_d[PLIMBS+1]; \
+	gnum_s name = {{{(int)PLIMBS,0,0,_##name##_d}},0,0}
+#define GB_VAR(name) \
+	mp_limb_t _##name##_l[PLIMBS+1]; \
+	mp_limb_t _##name##_r[PLIMBS+1]; \
+	gbnd_s name = {{{{(int)PLIMBS,0,0,_##name##_l}},0,0}, \
+	               {{{(int)PLIMBS,0,0,_##name##_r}},0,0},0}
+/* A gnum_s of n limbs precision, for temporaries as wide as their
+   operands. */
+#define GN_VARN(name,n) \
+	mp_limb_t _##name##_d[(n)+1]; \
+	gnum_s name = {{{(int)(n),0,0,_##name##_d}},0,0}
+/* A wider gbnd_s of the given precision, see MPF_VAR2 in mpx.h. */
+#define GB_VAR2(name,bits) \
+	int _##name##_p = MPF_BITS2LIMBS(bits); \
+	mp_limb_t _##name##_l[_##name##_p+1]; \
+	mp_limb_t _##name##_r[_##name##_p+1]; \
+	gbnd_s name = {{{{_##name##_p,0,0,_##name##_l}},0,0}, \
+	               {{{_##name##_p,0,0,_##name##_r}},0,0},0}
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
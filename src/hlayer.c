@@ -428,7 +428,7 @@ void uview_gb(const gbnd_s *gb)
 
 void view_uenv(void)
 {
-	if (MPX_PTR(one) == NULL) return;
+	if (one == NULL) return;
 
 #define SHOWI(i) printf("%-15s: %d\n", #i, (int)i);
 	printf("\n# int sizes #\n");
@@ -471,11 +471,15 @@ void view_uenv(void)
 #define SHOWF(f) gmp_printf("%-15s: %Fe\n", #f, f);
 	printf("\n# mp float extremes #\n");
 	SHOWF(maxreal);
+	SHOWF(negmaxreal);
 	SHOWF(smallsubnormal);
 }
 
 void print_stats(void)
 {
+	ustats_t stats;
+
+	ustats_get(&stats);
 	printf("ubits moved  : %lld\n", stats.ubitsmoved);
 	printf("ubnds moved  : %lld\n", stats.ubndsmoved);
 	if (stats.ubndsmoved) {
@@ -98,6 +98,8 @@ typedef mp_srcptr mpx_srcptr;
 #define _PAD(x) mpn_zero((x)->_mp_d+__GMP_ABS((x)->_mp_size),NLIMBS-__GMP_ABS((x)->_mp_size))
 #define mpx_set_f(x,f) do {mpz_t ztmp={{(int)NLIMBS,0,x}}; mpz_set_f(ztmp,f); _PAD(ztmp);} while (0)
 #define mpf_set_x(f,x) do {mpz_t ztmp; mpf_set_z(f,mpz_roinit_n(ztmp,x,NLIMBS));} while (0)
+/* set from n <= NLIMBS limbs */
+#define mpx_set_n(x,a,n) do {mpn_copyi(x,a,n); mpn_zero((x)+(n),NLIMBS-(n));} while (0)
 
 #else /* USE_MPN */
 
@@ -161,6 +163,7 @@ typedef mpz_srcptr mpx_srcptr;
 
 #define mpx_set_f(x,f)    mpz_set_f(x,f)
 #define mpf_set_x(f,x)    mpf_set_z(f,x)
+#define mpx_set_n(x,a,n)  do {mpz_t ztmp; mpz_set(x,mpz_roinit_n(ztmp,a,n));} while (0)
 
 #endif /* USE_MPN */
 
@@ -38,6 +38,22 @@ void utag(utag_s *ut, const unum_s *u)
 	ut->ubit = (u0 & mpx_get_ui(ubitmask)) >> (esizesize + fsizesize);
 }
 
+/* Bits in a ubound: the pair bit and the bits of each unum. */
+
+int nbitsu(const ubnd_s *u)
+{
+	int total = 1;
+	utag_s ut;
+
+	utag(&ut, u->l);
+	total += 1 + ut.esize + ut.fsize + utagsize;
+	if (u->p) {
+		utag(&ut, u->r);
+		total += 1 + ut.esize + ut.fsize + utagsize;
+	}
+	return total;
+}
+
 void signmask(unum_s *a, const unum_s *u)
 {
 	utag_s ut;
@@ -77,10 +93,18 @@ long scale(const mpf_s *f)
 
 int ne(const mpf_s *f)
 {
-	long sf, tmp;
+	if (mpf_sgn(f) == 0) return 1;
+	return nesf(scale(f));
+}
+
+/* Same as ne(), given the scale factor of a nonzero value. */
+
+int nesf(long sf)
+{
+	long tmp;
 	int nb;
 
-	if (mpf_sgn(f) == 0 || (sf = scale(f)) == 1) return 1;
+	if (sf == 1) return 1;
 	/* ceil(log2(abs(sf-1)+1))+1 */
 	tmp = labs(sf-1)+1;
 	/* ceil(log2(x)): 5->3, 4->2, 3->2, 2->1, 1->0 */
@@ -282,7 +306,8 @@ void demotee(unum_s *a, const unum_s *u)
 	utag_s ut;
 	MPX_VAR(tmp);
 	MPX_VAR(frac);
-	mpf_t f, fi;
+	MPF_VAR(f);
+	MPF_VAR(fi);
 
 	utag(&ut, u);
 	/* Cannot make the exponent any smaller. */
@@ -313,9 +338,6 @@ void demotee(unum_s *a, const unum_s *u)
 	mpx_and(tmp, u, tmp);
 	mpx_rshift(frac, tmp, utagsize);
 
-	mpf_init2(f, ut.fsize);
-	mpf_init2(fi, ut.fsize);
-
 	/* Subnormal, so decreasing expo size means
 	   shifting fraction right by 2^2^es-2 bits. */
 	if (expo == 0) {
@@ -327,8 +349,6 @@ void demotee(unum_s *a, const unum_s *u)
 		mpx_add_ui(a, a, (ut.ubit << (utagsize-1)) | ((ut.esize-2) << fsizesize) | (ut.fsize-1));
 		if (sign) mpx_setbit(a, spos-1);
 		if (mpf_cmp(fi, f) != 0) mpx_setbit(a, utagsize-1);
-		mpf_clear(fi);
-		mpf_clear(f);
 		return;
 	}
 
@@ -350,8 +370,6 @@ void demotee(unum_s *a, const unum_s *u)
 		mpx_add_ui(a, a, (ut.ubit << (utagsize-1)) | ((ut.esize-2) << fsizesize) | (ut.fsize-1));
 		if (sign) mpx_setbit(a, spos-1);
 		if (mpf_cmp(fi, f) != 0) mpx_setbit(a, utagsize-1);
-		mpf_clear(fi);
-		mpf_clear(f);
 		return;
 	}
 
@@ -372,8 +390,6 @@ void demotee(unum_s *a, const unum_s *u)
 		mpx_add_ui(a, a, (ut.ubit << (utagsize-1)) | ((ut.esize-2) << fsizesize) | (ut.fsize-1));
 		if (sign) mpx_setbit(a, spos-1);
 		if (mpf_cmp(fi, f) != 0) mpx_setbit(a, utagsize-1);
-		mpf_clear(fi);
-		mpf_clear(f);
 		return;
 	}
 
@@ -384,7 +400,4 @@ void demotee(unum_s *a, const unum_s *u)
 	mpx_lshift(a, a, utagsize-1);
 	mpx_add_ui(a, a, ((ut.esize-2) << fsizesize) | (ut.fsize-1));
 	if (sign) mpx_setbit(a, spos-1);
-
-	mpf_clear(fi);
-	mpf_clear(f);
 }
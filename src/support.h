@@ -27,6 +27,7 @@
 #define SUPPORT_H_
 
 #include "ulayer.h"
+#include "uenv.h" /* NLIMBS, for MPX_SIZ with USE_MPN */
 
 /* serves as a companion to ulayer */
 
@@ -37,17 +38,22 @@ typedef struct {
 } utag_s;
 typedef utag_s utag_t[1];
 
+/* Limb i of u, zero above its size */
+#define ULIMB(u,i) (((mp_size_t)(i) < MPX_SIZ(u)) ? MPX_PTR(u)[i] : 0)
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
 void utag(utag_s *ut, const unum_s *u);
+int nbitsu(const ubnd_s *u);
 
 void signmask(unum_s *a, const unum_s *u);
 void bigu(unum_s *a, const unum_s *u);
 
 long scale(const mpf_s *f);
 int ne(const mpf_s *f);
+int nesf(long sf);
 
 int inexQ(const unum_s *u);
 int exQ(const unum_s *u);
@@ -64,4 +70,22 @@ void demotee(unum_s *a, const unum_s *u);
 }
 #endif
 
+/* Copy len bits of u, starting at bit pos, into r[0..rn-1]. */
+
+static inline void getbitsu(mp_limb_t *r, mp_size_t rn, const unum_s *u, mp_bitcnt_t pos, mp_bitcnt_t len)
+{
+	mp_size_t i, li = pos / GMP_NUMB_BITS;
+	unsigned int sh = pos % GMP_NUMB_BITS;
+
+	for (i = 0; i < rn; i++) {
+		r[i] = ULIMB(u, li+i) >> sh;
+		if (sh) r[i] |= ULIMB(u, li+i+1) << (GMP_NUMB_BITS-sh);
+	}
+	i = len / GMP_NUMB_BITS;
+	if (i < rn) {
+		r[i] &= ((mp_limb_t)1 << (len % GMP_NUMB_BITS)) - 1;
+		for (i++; i < rn; i++) r[i] = 0;
+	}
+}
+
 #endif /* SUPPORT_H_ */
@@ -23,11 +23,17 @@
  * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
  */
 
+#include <stdlib.h> /* calloc */
+#include <string.h> /* memset */
+#include <pthread.h>
+
 #include "uenv.h"
 #include "ubnd.h"
 #include "gbnd.h"
 #include "support.h"
 #include "conv.h"
+#include "ubnd64.h"
+#include "gmp_macro.h" /* ABS, SIZ, EXP, PREC */
 
 #if defined(ROUND)
 #define G2U(ub,gb) g2ur(ub,gb)
@@ -68,165 +74,358 @@
 
 #endif /* ROUND */
 
-ustats_t stats;
+/* Operation counts. Each thread counts into its own block, found
+   through a thread-local pointer. Blocks are kept on a list so they can
+   be added up on demand. When a thread exits, its counts are moved to
+   retired and its block is reused by the next thread. */
+
+typedef struct ustats_b {
+	ustats_t s;
+	struct ustats_b *next;
+	int used;
+} ustats_b;
 
 #if defined(STATS)
+int ustats_on = 1;
+#else
+int ustats_on;
+#endif
+static UNUM_TLS ustats_b *tstats;
+static ustats_b *ustats_list;
+static ustats_t retired;
+static pthread_mutex_t ustats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t ustats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ustats_key;
+
+static void addstats(ustats_t *a, const ustats_t *b)
+{
+	long long int *pa = (long long int *)a;
+	const long long int *pb = (const long long int *)b;
+	size_t i;
 
-#define INTERVAL(ub) ((ub->p) ? 2 : inexQ(ub->l) ? 1 : 0)
+	for (i = 0; i < sizeof(ustats_t)/sizeof(long long int); i++) pa[i] += pb[i];
+}
+
+static void ustats_exit(void *arg)
+{
+	ustats_b *b = (ustats_b *)arg;
+
+	pthread_mutex_lock(&ustats_lock);
+	addstats(&retired, &b->s);
+	memset(&b->s, 0, sizeof(ustats_t));
+	b->used = 0;
+	pthread_mutex_unlock(&ustats_lock);
+}
 
-static int nbits(const ubnd_s *u)
+static void ustats_key_init(void)
 {
-	int total = 1;
-	utag_s ut;
+	pthread_key_create(&ustats_key, ustats_exit);
+}
 
-	utag(&ut, u->l);
-	total += 1 + ut.esize + ut.fsize + utagsize;
-	if (u->p) {
-		utag(&ut, u->r);
-		total += 1 + ut.esize + ut.fsize + utagsize;
+/* Block of the calling thread, taken on first use. */
+
+static ustats_t *mystats(void)
+{
+	ustats_b *b;
+
+	if (tstats) return &tstats->s;
+	pthread_once(&ustats_once, ustats_key_init);
+	pthread_mutex_lock(&ustats_lock);
+	for (b = ustats_list; b && b->used; b = b->next) ;
+	if (!b) {
+		b = (ustats_b *)calloc(1, sizeof(ustats_b));
+		b->next = ustats_list;
+		ustats_list = b;
 	}
+	b->used = 1;
+	pthread_mutex_unlock(&ustats_lock);
+	pthread_setspecific(ustats_key, b);
+	tstats = b;
+	return &b->s;
+}
+
+int ustats_enable(int on)
+{
+	return __atomic_exchange_n(&ustats_on, on, __ATOMIC_RELAXED);
+}
+
+void ustats_reset(void)
+{
+	ustats_b *b;
+
+	pthread_mutex_lock(&ustats_lock);
+	memset(&retired, 0, sizeof(ustats_t));
+	for (b = ustats_list; b; b = b->next) memset(&b->s, 0, sizeof(ustats_t));
+	pthread_mutex_unlock(&ustats_lock);
+}
+
+void ustats_get(ustats_t *s)
+{
+	ustats_b *b;
+
+	pthread_mutex_lock(&ustats_lock);
+	*s = retired;
+	for (b = ustats_list; b; b = b->next) addstats(s, &b->s);
+	pthread_mutex_unlock(&ustats_lock);
+}
+
+#define INTERVAL(ub) ((ub->p) ? 2 : inexQ(ub->l) ? 1 : 0)
+
+static int nbits(ustats_t *stats, const ubnd_s *u)
+{
+	int total = nbitsu(u);
+
 #if defined(NBITS_HISTO)
-	if (total <= MAX_NBITS) stats.nbits[total]++;
+	if (total <= MAX_NBITS) stats->nbits[total]++;
+#else
+	(void)stats;
 #endif
 	return total;
 }
 
 static void tally2(const ubnd_s *a, const ubnd_s *u)
 {
-	stats.ubitsmoved += nbits(a) + nbits(u);
-	stats.ubndsmoved += 2;
-	stats.ops++;
-	stats.opc2[INTERVAL(a)][INTERVAL(u)]++;
+	ustats_t *stats = mystats();
+
+	stats->ubitsmoved += nbits(stats, a) + nbits(stats, u);
+	stats->ubndsmoved += 2;
+	stats->ops++;
+	stats->opc2[INTERVAL(a)][INTERVAL(u)]++;
 }
 
 static void tally3(const ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
 {
-	stats.ubitsmoved += nbits(a) + nbits(u) + nbits(v);
-	stats.ubndsmoved += 3;
-	stats.ops++;
-	stats.opc3[INTERVAL(a)][INTERVAL(u)][INTERVAL(v)]++;
+	ustats_t *stats = mystats();
+
+	stats->ubitsmoved += nbits(stats, a) + nbits(stats, u) + nbits(stats, v);
+	stats->ubndsmoved += 3;
+	stats->ops++;
+	stats->opc3[INTERVAL(a)][INTERVAL(u)][INTERVAL(v)]++;
+}
+
+/* A fused operation moves its result and each of its operands once. */
+
+static void tallyn(const ubnd_s *a, const ubnd_s *u, size_t nu, const ubnd_s *v, size_t nv)
+{
+	ustats_t *stats = mystats();
+	size_t i;
+
+	stats->ubitsmoved += nbits(stats, a);
+	for (i = 0; i < nu; i++) stats->ubitsmoved += nbits(stats, u+i);
+	for (i = 0; i < nv; i++) stats->ubitsmoved += nbits(stats, v+i);
+	stats->ubndsmoved += 1 + nu + nv;
+	stats->ops++;
 }
 
-#define TALLY2(a,u) tally2(a,u);
-#define TALLY3(a,u,v) tally3(a,u,v);
+#define TALLY2(a,u) if (USTATS_ON()) tally2(a,u);
+#define TALLY3(a,u,v) if (USTATS_ON()) tally3(a,u,v);
+#define TALLYN(a,u,nu,v,nv) if (USTATS_ON()) tallyn(a,u,nu,v,nv);
 
+#if defined(HAVE_UBND64)
+/* Use the native engine when the environment fits in 64 bits. */
+#define CMP64(res) if (uenv64) {ENV64_VAR(env64); return res;}
+#define OP64(done,tally) if (uenv64) {ENV64_VAR(env64); if (done) {tally return;}}
 #else
-#define TALLY2(a,u)
-#define TALLY3(a,u,v)
+#define CMP64(res)
+#define OP64(done,tally)
 #endif
 
-/* Test if ubound u is strictly less than ubound v. */
+/* Bit-level comparison of ubounds. An end point is decoded straight from
+   the unum bit string into a sign, a scale and a left-aligned significand,
+   following the cases of unum2g(), so no g-layer conversion is needed. */
 
-int ltuQ(const ubnd_s *u, const ubnd_s *v)
+/* Limbs for a significand of fsizemax+1 bits plus a carry. */
+#define SLIMBS ((mp_size_t)(fsizemax+1)/GMP_NUMB_BITS+1)
+#define MAX_SLIMBS (MAX_FSIZE/GMP_NUMB_BITS+2)
+
+typedef struct {
+	long s; /* scale, |value| is in [2^s, 2^(s+1)) */
+	mp_limb_t m[MAX_SLIMBS]; /* significand, msb is top bit of m[n-1] */
+	int sgn; /* -1, 0 or 1 */
+	unsigned int open : 1;
+	unsigned int inf : 1;
+} uend_s;
+
+/* Decode end point e of unum u, ignoring NaN. */
+
+static void uend(uend_s *a, const unum_s *u, end_t e, mp_size_t n)
+{
+	mp_limb_t tag = ULIMB(u, 0);
+	mp_limb_t m[MAX_SLIMBS];
+	mp_limb_t expo;
+	mp_size_t hi, q;
+	long bias, s0;
+	int fs, es, neg, inf, up = 0;
+	size_t bl;
+
+	if ((inf = infuQ(u)) != 0) {
+		a->sgn = inf; a->inf = 1; a->open = 0;
+		return;
+	}
+	fs = (tag & (((mp_limb_t)1 << fsizesize) - 1)) + 1;
+	es = ((tag >> fsizesize) & (((mp_limb_t)1 << esizesize) - 1)) + 1;
+	getbitsu(&expo, 1, u, utagsize + fs, es);
+	getbitsu(m, n, u, utagsize, fs);
+	neg = mpx_tstbit(u, utagsize + fs + es);
+	a->inf = 0;
+	a->open = (tag >> (utagsize-1)) & 1;
+	if (a->open) {
+		mp_bitcnt_t ones = (expo == ((mp_limb_t)1 << es) - 1) ? mpn_popcount(m, n) : 0;
+		/* (bigu, Inf) and (-Inf, -bigu) */
+		if ((es == esizemax && fs == fsizemax) ?
+			(ones == (mp_bitcnt_t)fs-1 && !(m[0] & 1)) : ones == (mp_bitcnt_t)fs) {
+			if (e == ((neg) ? LE : RE)) {
+				a->sgn = (neg) ? -1 : 1; a->inf = 1;
+				return;
+			}
+		} else {
+			/* If negative, left end point is farther from zero. */
+			up = (e == ((neg) ? LE : RE));
+		}
+	}
+	bias = (1L << (es-1)) - 1;
+	if (expo) {
+		m[fs / GMP_NUMB_BITS] |= (mp_limb_t)1 << (fs % GMP_NUMB_BITS);
+		s0 = (long)expo - bias;
+	} else {
+		s0 = 1 - bias;
+	}
+	if (up) mpn_add_1(m, m, n, 1);
+	for (hi = n-1; hi >= 0 && m[hi] == 0; hi--) ;
+	if (hi < 0) {
+		a->sgn = 0;
+		return;
+	}
+	a->sgn = (neg) ? -1 : 1;
+	bl = mpn_sizeinbase(m, hi+1, 2);
+	a->s = s0 - fs + (long)bl - 1;
+	/* left-align the significand */
+	bl = n * GMP_NUMB_BITS - bl;
+	q = bl / GMP_NUMB_BITS;
+	if (bl % GMP_NUMB_BITS) mpn_lshift(a->m + q, m, n - q, bl % GMP_NUMB_BITS);
+	else mpn_copyi(a->m + q, m, n - q);
+	if (q) mpn_zero(a->m, q);
+}
+
+/* Decode end point e of ubound u. */
+
+static void ubend(uend_s *a, const ubnd_s *u, end_t e, mp_size_t n)
+{
+	uend(a, (e == RE && u->p) ? u->r : u->l, e, n);
+}
+
+static int nanubQ(const ubnd_s *u)
+{
+	return nanuQ(u->l) || (u->p && nanuQ(u->r));
+}
+
+/* Compare values of end points, infinities included, like mpf_cmp(). */
+
+static int cmpv_ue(const uend_s *x, const uend_s *y, mp_size_t n)
 {
 	int res;
-	gbnd_s g, h;
 
-	gbnd_init(&g);
-	gbnd_init(&h);
+	if ( x->inf && !y->inf) return  x->sgn;
+	if (!x->inf &&  y->inf) return -y->sgn;
+	if (x->sgn != y->sgn) return (x->sgn > y->sgn) ? 1 : -1;
+	if (x->inf || x->sgn == 0) return 0;
+	if (x->s != y->s) return (x->s > y->s) ? x->sgn : -x->sgn;
+	res = mpn_cmp(x->m, y->m, n);
+	return (res > 0) ? x->sgn : (res < 0) ? -x->sgn : 0;
+}
 
-	u2g(&g, u);
-	u2g(&h, v);
-	res = ltgQ(&g, &h);
+/* Comparison of interval end points, see cmp_gn() in glayer.h */
 
-	gbnd_clear(&h);
-	gbnd_clear(&g);
-	return res;
+static int cmp_ue(const uend_s *x, end_t xe, const uend_s *y, end_t ye, mp_size_t n)
+{
+	int res;
+
+	if ((res = cmpv_ue(x, y, n)) != 0) return res;
+	return ((x->open)?xe:1) - ((y->open)?ye:1);
+}
+
+/* Test if ubound u is strictly less than ubound v. */
+
+int ltuQ(const ubnd_s *u, const ubnd_s *v)
+{
+	mp_size_t n = SLIMBS;
+	uend_s x, y;
+
+	CMP64(ltuQ64(&env64, u, v));
+
+	if (nanubQ(u) || nanubQ(v)) return 0;
+	ubend(&x, u, RE, n);
+	ubend(&y, v, LE, n);
+	return cmp_ue(&x, RE, &y, LE, n) < 0;
 }
 
 /* Test if ubound u is strictly greater than ubound v. */
 
 int gtuQ(const ubnd_s *u, const ubnd_s *v)
 {
-	int res;
-	gbnd_s g, h;
-
-	gbnd_init(&g);
-	gbnd_init(&h);
+	mp_size_t n = SLIMBS;
+	uend_s x, y;
 
-	u2g(&g, u);
-	u2g(&h, v);
-	res = gtgQ(&g, &h);
+	CMP64(gtuQ64(&env64, u, v));
 
-	gbnd_clear(&h);
-	gbnd_clear(&g);
-	return res;
+	if (nanubQ(u) || nanubQ(v)) return 0;
+	ubend(&x, u, LE, n);
+	ubend(&y, v, RE, n);
+	return cmp_ue(&x, LE, &y, RE, n) > 0;
 }
 
 /* Test if ubound u is nowhere equal to ubound v. */
 
 int nequQ(const ubnd_s *u, const ubnd_s *v)
 {
-	int res;
-	gbnd_s g, h;
-
-	gbnd_init(&g);
-	gbnd_init(&h);
+	CMP64(nequQ64(&env64, u, v));
 
-	u2g(&g, u);
-	u2g(&h, v);
-	res = neqgQ(&g, &h);
-
-	gbnd_clear(&h);
-	gbnd_clear(&g);
-	return res;
+	return ltuQ(u, v) || gtuQ(u, v);
 }
 
 /* Test if ubound u is not nowhere (somewhere) equal to ubound v. */
 
 int nnequQ(const ubnd_s *u, const ubnd_s *v)
 {
-	int res;
-	gbnd_s g, h;
-
-	gbnd_init(&g);
-	gbnd_init(&h);
+	CMP64(nnequQ64(&env64, u, v));
 
-	u2g(&g, u);
-	u2g(&h, v);
-	res = nneqgQ(&g, &h);
-
-	gbnd_clear(&h);
-	gbnd_clear(&g);
-	return res;
+	return !(nanubQ(u) || nanubQ(v)) && !(ltuQ(u, v) || gtuQ(u, v));
 }
 
 /* Test if ubound u value is identical to ubound v value. */
 
 int sameuQ(const ubnd_s *u, const ubnd_s *v)
 {
-	int res;
-	gbnd_s g, h;
-
-	gbnd_init(&g);
-	gbnd_init(&h);
-
-	u2g(&g, u);
-	u2g(&h, v);
-	res = samegQ(&g, &h);
-
-	gbnd_clear(&h);
-	gbnd_clear(&g);
-	return res;
+	mp_size_t n = SLIMBS;
+	uend_s x, y;
+	int gnan, hnan;
+
+	CMP64(sameuQ64(&env64, u, v));
+
+	gnan = nanubQ(u);
+	hnan = nanubQ(v);
+	if (gnan || hnan) return gnan && hnan;
+	ubend(&x, u, LE, n);
+	ubend(&y, v, LE, n);
+	if (cmpv_ue(&x, &y, n) != 0 || x.inf != y.inf || x.open != y.open) return 0;
+	ubend(&x, u, RE, n);
+	ubend(&y, v, RE, n);
+	return cmpv_ue(&x, &y, n) == 0 && x.inf == y.inf && x.open == y.open;
 }
 
 /* Compare end points from ubounds u and v. */
 
 int cmpuQ(const ubnd_s *u, end_t ue, const ubnd_s *v, end_t ve)
 {
-	int res;
-	gbnd_s g, h;
+	mp_size_t n = SLIMBS;
+	uend_s x, y;
 
-	gbnd_init(&g);
-	gbnd_init(&h);
+	CMP64(cmpuQ64(&env64, u, ue, v, ve));
 
-	u2g(&g, u);
-	u2g(&h, v);
-	res = cmpgQ(&g, ue, &h, ve);
-
-	gbnd_clear(&h);
-	gbnd_clear(&g);
-	return res;
+	if (nanubQ(u) || nanubQ(v)) return 0;
+	ubend(&x, u, ue, n);
+	ubend(&y, v, ve, n);
+	return cmp_ue(&x, ue, &y, ve, n);
 }
 
 /* Test if a ubound spans zero. */
@@ -234,103 +433,255 @@ int cmpuQ(const ubnd_s *u, end_t ue, const ubnd_s *v, end_t ve)
 int spanszerouQ(const ubnd_s *u)
 {
 	int res;
-	gbnd_s g;
+	GB_VAR(g);
 
-	gbnd_init(&g);
+	CMP64(spanszerouQ64(&env64, u));
 
 	u2g(&g, u);
 	res = spanszerogQ(&g);
 
-	gbnd_clear(&g);
 	return res;
 }
 
-/* Addition in the u-layer. */
+/* Exact u-layer kernels. A single, exact, finite unum is decoded as
+   (-1)^neg * m * 2^e with an integer significand, the operation is done
+   on the limbs and the result is encoded by mpn2u(). Other operands are
+   left to the g-layer. The limb counts come from the operand utags, not
+   from fsizemax, so short unums in a wide environment stay cheap. */
+
+typedef struct {
+	mp_limb_t m[MAX_SLIMBS];
+	mp_size_t n; /* limbs in m, for fsize+1 bits */
+	long e;
+	int neg;
+} xnum_s;
+
+/* Decode a ubound that is a single, exact, finite unum. */
+
+static int exactx(xnum_s *a, const ubnd_s *ub)
+{
+	mp_size_t n;
+	mp_limb_t tag, expo;
+	int fs, es;
+
+	if (ub->p || !exQ(ub->l) || infuQ(ub->l)) return 0;
+	tag = ULIMB(ub->l, 0);
+	fs = (tag & (((mp_limb_t)1 << fsizesize) - 1)) + 1;
+	es = ((tag >> fsizesize) & (((mp_limb_t)1 << esizesize) - 1)) + 1;
+	a->n = n = fs / GMP_NUMB_BITS + 1;
+	getbitsu(&expo, 1, ub->l, utagsize + fs, es);
+	getbitsu(a->m, n, ub->l, utagsize, fs);
+	a->neg = mpx_tstbit(ub->l, utagsize + fs + es);
+	if (expo) {
+		a->m[fs / GMP_NUMB_BITS] |= (mp_limb_t)1 << (fs % GMP_NUMB_BITS);
+		a->e = (long)expo - ((1L << (es-1)) - 1) - fs;
+	} else {
+		a->e = 1 - ((1L << (es-1)) - 1) - fs;
+	}
+	return 1;
+}
+
+/* Store an exact result as a single unum, like g2u() does for [x, x]. */
+
+static int putx(ubnd_s *a, int neg, const mp_limb_t *m, mp_size_t n, long e)
+{
+	a->p = 0;
+	mpn2u(a->l, neg, m, n, e);
+#if defined(ROUND)
+	roundu(a->l);
+#endif
+	mpx_set(a->r, a->l);
+	return 1;
+}
+
+/* Exact sum or difference of exact operands. Sums wider than the
+   g-layer precision are left to plusg() so the results stay the same. */
+
+static int plusx(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, int sub)
+{
+	mp_limb_t r[MAX_PLIMBS], t[MAX_PLIMBS];
+	const xnum_s *x, *y;
+	xnum_s xu, xv;
+	mp_size_t q, rn;
+	long d;
+
+	if (!exactx(&xu, u) || !exactx(&xv, v)) return 0;
+	xv.neg ^= sub;
+	/* x has the lower exponent */
+	if (xu.e <= xv.e) {x = &xu; y = &xv;}
+	else {x = &xv; y = &xu;}
+	d = y->e - x->e;
+	q = d / GMP_NUMB_BITS;
+	rn = ((q + y->n > x->n) ? q + y->n : x->n) + 1;
+	if (rn > PLIMBS - 1) return 0;
+	mpn_zero(r, q);
+	if (d % GMP_NUMB_BITS) r[q + y->n] = mpn_lshift(r + q, y->m, y->n, d % GMP_NUMB_BITS);
+	else {mpn_copyi(r + q, y->m, y->n); r[q + y->n] = 0;}
+	if (q + y->n + 1 < rn) mpn_zero(r + q + y->n + 1, rn - (q + y->n + 1));
+	if (x->neg == y->neg) {
+		mpn_add(r, r, rn, x->m, x->n);
+		return putx(a, x->neg, r, rn, x->e);
+	}
+	mpn_copyi(t, x->m, x->n);
+	mpn_zero(t + x->n, rn - x->n);
+	if (mpn_cmp(t, r, rn) >= 0) {
+		mpn_sub_n(r, t, r, rn);
+		return putx(a, x->neg, r, rn, x->e);
+	}
+	mpn_sub_n(r, r, t, rn);
+	return putx(a, y->neg, r, rn, x->e);
+}
+
+/* Exact product of exact operands, sized by the operand fractions.
+   Products wider than the g-layer precision are left to timesg(). */
+
+static int timesx(ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
+{
+	mp_limb_t r[MAX_PLIMBS];
+	xnum_s xu, xv;
+	mp_size_t rn;
+
+	if (!exactx(&xu, u) || !exactx(&xv, v)) return 0;
+	rn = xu.n + xv.n;
+	if (rn > PLIMBS - 1) return 0;
+	if (xu.n >= xv.n) mpn_mul(r, xu.m, xu.n, xv.m, xv.n);
+	else mpn_mul(r, xv.m, xv.n, xu.m, xu.n);
+	return putx(a, xu.neg ^ xv.neg, r, rn, xu.e + xv.e);
+}
+
+/* Addition in the u-layer, using g-layer temporaries g, h and x. */
 /* With tallying of bits and numbers moved. */
 
+static void plust(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, gbnd_s *g, gbnd_s *h, gbnd_s *x)
+{
+	OP64(plusu64(&env64, a, u, v), TALLY3(a,u,v))
+	if (plusx(a, u, v, 0)) {TALLY3(a,u,v) return;}
+
+	u2g(g, u);
+	u2g(h, v);
+	plusg(x, g, h);
+	G2U(a, x);
+	TALLY3(a,u,v)
+}
+
 void plusu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
 {
-	gbnd_s g, h, x;
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR(x);
 
-	gbnd_init(&g);
-	gbnd_init(&h);
-	gbnd_init(&x);
+	plust(a, u, v, &g, &h, &x);
+}
 
-	u2g(&g, u);
-	u2g(&h, v);
-	plusg(&x, &g, &h);
-	G2U(a, &x);
-	TALLY3(a,u,v)
+void plusu_n(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n)
+{
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR(x);
+	size_t i;
 
-	gbnd_clear(&x);
-	gbnd_clear(&h);
-	gbnd_clear(&g);
+	for (i = 0; i < n; i++) plust(a+i, u+i, v+i, &g, &h, &x);
 }
 
-/* Subtraction in the u-layer. */
+/* Subtraction in the u-layer, using g-layer temporaries g, h and x. */
 /* With tallying of bits and numbers moved. */
 
+static void minust(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, gbnd_s *g, gbnd_s *h, gbnd_s *x)
+{
+	OP64(minusu64(&env64, a, u, v), TALLY3(a,u,v))
+	if (plusx(a, u, v, 1)) {TALLY3(a,u,v) return;}
+
+	u2g(g, u);
+	u2g(h, v);
+	minusg(x, g, h);
+	G2U(a, x);
+	TALLY3(a,u,v)
+}
+
 void minusu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
 {
-	gbnd_s g, h, x;
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR(x);
 
-	gbnd_init(&g);
-	gbnd_init(&h);
-	gbnd_init(&x);
+	minust(a, u, v, &g, &h, &x);
+}
 
-	u2g(&g, u);
-	u2g(&h, v);
-	minusg(&x, &g, &h);
-	G2U(a, &x);
-	TALLY3(a,u,v)
+void minusu_n(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n)
+{
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR(x);
+	size_t i;
 
-	gbnd_clear(&x);
-	gbnd_clear(&h);
-	gbnd_clear(&g);
+	for (i = 0; i < n; i++) minust(a+i, u+i, v+i, &g, &h, &x);
 }
 
-/* Multiplication in the u-layer. */
+/* Multiplication in the u-layer, using g-layer temporaries g, h and x. */
 /* With tallying of bits and numbers moved. */
 
+static void timest(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, gbnd_s *g, gbnd_s *h, gbnd_s *x)
+{
+	OP64(timesu64(&env64, a, u, v), TALLY3(a,u,v))
+	if (timesx(a, u, v)) {TALLY3(a,u,v) return;}
+
+	u2g(g, u);
+	u2g(h, v);
+	timesg(x, g, h);
+	G2U(a, x);
+	TALLY3(a,u,v)
+}
+
 void timesu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
 {
-	gbnd_s g, h, x;
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR(x);
 
-	gbnd_init(&g);
-	gbnd_init(&h);
-	gbnd_init(&x);
+	timest(a, u, v, &g, &h, &x);
+}
 
-	u2g(&g, u);
-	u2g(&h, v);
-	timesg(&x, &g, &h);
-	G2U(a, &x);
-	TALLY3(a,u,v)
+void timesu_n(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n)
+{
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR(x);
+	size_t i;
 
-	gbnd_clear(&x);
-	gbnd_clear(&h);
-	gbnd_clear(&g);
+	for (i = 0; i < n; i++) timest(a+i, u+i, v+i, &g, &h, &x);
 }
 
-/* Division in the u-layer. */
+/* Division in the u-layer, using g-layer temporaries g, h and x. */
 /* With tallying of bits and numbers moved. */
 
+static void dividet(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, gbnd_s *g, gbnd_s *h, gbnd_s *x)
+{
+	OP64(divideu64(&env64, a, u, v), TALLY3(a,u,v))
+
+	u2g(g, u);
+	u2g(h, v);
+	divideg(x, g, h);
+	G2U(a, x);
+	TALLY3(a,u,v)
+}
+
 void divideu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
 {
-	gbnd_s g, h, x;
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR(x);
 
-	gbnd_init(&g);
-	gbnd_init(&h);
-	gbnd_init(&x);
+	dividet(a, u, v, &g, &h, &x);
+}
 
-	u2g(&g, u);
-	u2g(&h, v);
-	divideg(&x, &g, &h);
-	G2U(a, &x);
-	TALLY3(a,u,v)
+void divideu_n(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n)
+{
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR(x);
+	size_t i;
 
-	gbnd_clear(&x);
-	gbnd_clear(&h);
-	gbnd_clear(&g);
+	for (i = 0; i < n; i++) dividet(a+i, u+i, v+i, &g, &h, &x);
 }
 
 /* Square in the u-layer. */
@@ -338,37 +689,210 @@ void divideu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
 
 void squareu(ubnd_s *a, const ubnd_s *u)
 {
-	gbnd_s g, x;
+	GB_VAR(g);
+	GB_VAR(x);
 
-	gbnd_init(&g);
-	gbnd_init(&x);
+	OP64(squareu64(&env64, a, u), TALLY2(a,u))
 
 	u2g(&g, u);
 	squareg(&x, &g);
 	G2U(a, &x);
 	TALLY2(a,u)
-
-	gbnd_clear(&x);
-	gbnd_clear(&g);
 }
 
-/* Square root in the u-layer. */
+/* Square root in the u-layer, using g-layer temporaries g and x. */
 /* With tallying of bits and numbers moved. */
 
+static void sqrtt(ubnd_s *a, const ubnd_s *u, gbnd_s *g, gbnd_s *x)
+{
+	OP64(sqrtu64(&env64, a, u), TALLY2(a,u))
+
+	u2g(g, u);
+	sqrtg(x, g);
+	G2U(a, x);
+	TALLY2(a,u)
+}
+
 void sqrtu(ubnd_s *a, const ubnd_s *u)
 {
-	gbnd_s g, x;
+	GB_VAR(g);
+	GB_VAR(x);
 
-	gbnd_init(&g);
-	gbnd_init(&x);
+	sqrtt(a, u, &g, &x);
+}
 
-	u2g(&g, u);
-	sqrtg(&x, &g);
-	G2U(a, &x);
-	TALLY2(a,u)
+void sqrtu_n(ubnd_s *a, const ubnd_s *u, size_t n)
+{
+	GB_VAR(g);
+	GB_VAR(x);
+	size_t i;
+
+	for (i = 0; i < n; i++) sqrtt(a+i, u+i, &g, &x);
+}
+
+/* The fused ops keep their sums and products exact in a g-layer
+   accumulator whose precision grows with the operands, and convert the
+   result to a ubound once. A product of two unums has at most
+   2*(fsizemax+1) bits, so it is exact at 2*PBITS. */
+
+/* Start an accumulator at v, 0 for a sum or 1 for a product. */
+
+static void accinit(gbnd_s *s, unsigned long v)
+{
+	gbnd_init(s);
+	s->nan = 0;
+	mpf_set_ui(s->l.f, v); s->l.inf = 0; s->l.open = 0;
+	mpf_set_ui(s->r.f, v); s->r.inf = 0; s->r.open = 0;
+}
+
+/* Grow f to at least n limbs, keeping its value. */
+
+static void accgrow(mpf_s *f, mp_size_t n)
+{
+	if (n > PREC(f)) mpf_set_prec(f, n * GMP_NUMB_BITS);
+}
+
+/* Limbs of the exact sum of x and y: from the top of the higher one to
+   the bottom of the lower one, plus a carry. */
+
+static mp_size_t addspan(const mpf_s *x, const mpf_s *y)
+{
+	mp_size_t xn = ABS(SIZ(x)), yn = ABS(SIZ(y));
+
+	if (!xn || !yn) return xn + yn;
+	return ((EXP(x) > EXP(y)) ? EXP(x) : EXP(y)) -
+		((EXP(x) - xn < EXP(y) - yn) ? EXP(x) - xn : EXP(y) - yn) + 1;
+}
+
+/* s = s + g, exactly. */
+
+static void accplus(gbnd_s *s, const gbnd_s *g)
+{
+	accgrow(s->l.f, addspan(s->l.f, g->l.f));
+	accgrow(s->r.f, addspan(s->r.f, g->r.f));
+	plusg(s, s, g);
+}
+
+/* p = p * g, exactly: the limbs of the wider end of each. */
+
+static void acctimes(gbnd_s *p, const gbnd_s *g)
+{
+	mp_size_t pn = ABS(SIZ(p->l.f)), gn = ABS(SIZ(g->l.f));
+
+	if (ABS(SIZ(p->r.f)) > pn) pn = ABS(SIZ(p->r.f));
+	if (ABS(SIZ(g->r.f)) > gn) gn = ABS(SIZ(g->r.f));
+	accgrow(p->l.f, pn + gn);
+	accgrow(p->r.f, pn + gn);
+	timesg(p, p, g);
+}
+
+/* Fused multiply-add in the u-layer, x*y+z. */
+
+void fmau(ubnd_s *a, const ubnd_s *x, const ubnd_s *y, const ubnd_s *z)
+{
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR2(p, 2*PBITS);
+	gbnd_s s;
+
+	u2g(&g, x);
+	u2g(&h, y);
+	timesg(&p, &g, &h);
+	u2g(&g, z);
+	accinit(&s, 0);
+	accplus(&s, &p);
+	accplus(&s, &g);
+	G2U(a, &s);
+	gbnd_clear(&s);
+	if (USTATS_ON()) {
+		ubnd_s t[3];
+		t[0] = *x; t[1] = *y; t[2] = *z;
+		tallyn(a, t, 3, NULL, 0);
+	}
+}
+
+/* Fused dot product in the u-layer. */
 
-	gbnd_clear(&x);
-	gbnd_clear(&g);
+void fdotu(ubnd_s *a, const ubnd_s *x, const ubnd_s *y, size_t n)
+{
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR2(p, 2*PBITS);
+	gbnd_s s;
+	size_t i;
+
+	accinit(&s, 0);
+	for (i = 0; i < n && !s.nan; i++) {
+		u2g(&g, x+i);
+		u2g(&h, y+i);
+		timesg(&p, &g, &h);
+		accplus(&s, &p);
+	}
+	G2U(a, &s);
+	gbnd_clear(&s);
+	TALLYN(a, x, n, y, n)
+}
+
+/* Fused sum in the u-layer. */
+
+void fsumu(ubnd_s *a, const ubnd_s *u, size_t n)
+{
+	GB_VAR(g);
+	gbnd_s s;
+	size_t i;
+
+	accinit(&s, 0);
+	for (i = 0; i < n && !s.nan; i++) {
+		u2g(&g, u+i);
+		accplus(&s, &g);
+	}
+	G2U(a, &s);
+	gbnd_clear(&s);
+	TALLYN(a, u, n, NULL, 0)
+}
+
+/* Product of n ubounds in accumulator p, one for n = 0. */
+
+static void prodg(gbnd_s *p, const ubnd_s *u, size_t n)
+{
+	GB_VAR(g);
+	size_t i;
+
+	accinit(p, 1);
+	for (i = 0; i < n && !p->nan; i++) {
+		u2g(&g, u+i);
+		acctimes(p, &g);
+	}
+}
+
+/* Fused product in the u-layer. */
+
+void fprodu(ubnd_s *a, const ubnd_s *u, size_t n)
+{
+	gbnd_s p;
+
+	prodg(&p, u, n);
+	G2U(a, &p);
+	gbnd_clear(&p);
+	TALLYN(a, u, n, NULL, 0)
+}
+
+/* Fused product ratio in the u-layer, the product of num over the product
+   of den. The quotient is formed at the precision of the wider product. */
+
+void fprodratiou(ubnd_s *a, const ubnd_s *num, size_t nnum, const ubnd_s *den, size_t nden)
+{
+	gbnd_s p, q;
+
+	prodg(&p, num, nnum);
+	prodg(&q, den, nden);
+	accgrow(p.l.f, PREC(q.l.f));
+	accgrow(p.r.f, PREC(q.r.f));
+	divideg(&p, &p, &q);
+	G2U(a, &p);
+	gbnd_clear(&p);
+	gbnd_clear(&q);
+	TALLYN(a, num, nnum, den, nden)
 }
 
 /* Negate a ubound. */
@@ -397,96 +921,69 @@ void negateu(ubnd_s *a, const ubnd_s *u)
 
 void absu(ubnd_s *a, const ubnd_s *u)
 {
-	gbnd_s g, x;
-
-	gbnd_init(&g);
-	gbnd_init(&x);
+	GB_VAR(g);
+	GB_VAR(x);
 
 	u2g(&g, u);
 	absg(&x, &g);
 	G2U(a, &x);
 	TALLY2(a,u)
-
-	gbnd_clear(&x);
-	gbnd_clear(&g);
 }
 
 void minu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
 {
-	gbnd_s g, h, x;
-
-	gbnd_init(&g);
-	gbnd_init(&h);
-	gbnd_init(&x);
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR(x);
 
 	u2g(&g, u);
 	u2g(&h, v);
 	ming(&x, &g, &h);
 	G2U(a, &x);
 	TALLY3(a,u,v)
-
-	gbnd_clear(&x);
-	gbnd_clear(&h);
-	gbnd_clear(&g);
 }
 
 void maxu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
 {
-	gbnd_s g, h, x;
-
-	gbnd_init(&g);
-	gbnd_init(&h);
-	gbnd_init(&x);
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR(x);
 
 	u2g(&g, u);
 	u2g(&h, v);
 	maxg(&x, &g, &h);
 	G2U(a, &x);
 	TALLY3(a,u,v)
-
-	gbnd_clear(&x);
-	gbnd_clear(&h);
-	gbnd_clear(&g);
 }
 
 int cliplu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
 {
-	gbnd_s g, h, x;
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR(x);
 	int res;
 
-	gbnd_init(&g);
-	gbnd_init(&h);
-	gbnd_init(&x);
-
 	u2g(&g, u);
 	u2g(&h, v);
 	res = cliplg(&x, &g, &h);
 	G2U(a, &x);
 	TALLY3(a,u,v)
 
-	gbnd_clear(&x);
-	gbnd_clear(&h);
-	gbnd_clear(&g);
 	return res;
 }
 
 int cliphu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
 {
-	gbnd_s g, h, x;
+	GB_VAR(g);
+	GB_VAR(h);
+	GB_VAR(x);
 	int res;
 
-	gbnd_init(&g);
-	gbnd_init(&h);
-	gbnd_init(&x);
-
 	u2g(&g, u);
 	u2g(&h, v);
 	res = cliphg(&x, &g, &h);
 	G2U(a, &x);
 	TALLY3(a,u,v)
 
-	gbnd_clear(&x);
-	gbnd_clear(&h);
-	gbnd_clear(&g);
 	return res;
 }
@@ -42,12 +42,27 @@ typedef struct {
 #endif
 } ustats_t;
 
-extern ustats_t stats;
 
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
+/* Operation counts are off unless compiled with STATS, and can be
+   switched at run time; ustats_enable returns the previous setting.
+   Each thread counts on its own, and ustats_get adds up all threads,
+   including those that have exited. Counts of running threads are
+   read as they are, so they are exact when those threads are idle.
+   These replace the thread-local variable stats of earlier versions,
+   which is gone: read the counts with ustats_get instead. */
+int ustats_enable(int on);
+void ustats_reset(void);
+void ustats_get(ustats_t *s);
+
+/* Switched by any thread while others tally, so it is read and written
+   atomically; relaxed order is enough for an on/off flag. */
+extern int ustats_on;
+#define USTATS_ON() __atomic_load_n(&ustats_on, __ATOMIC_RELAXED)
+
 int ltuQ(const ubnd_s *u, const ubnd_s *v);
 int gtuQ(const ubnd_s *u, const ubnd_s *v);
 int nequQ(const ubnd_s *u, const ubnd_s *v);
@@ -63,6 +78,21 @@ void minusu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v);
 void timesu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v);
 void divideu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v);
 
+/* Element-wise over arrays of n ubounds, sharing one set of g-layer
+   temporaries. Each element is tallied as a separate operation. */
+void plusu_n(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n);
+void minusu_n(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n);
+void timesu_n(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n);
+void divideu_n(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n);
+void sqrtu_n(ubnd_s *a, const ubnd_s *u, size_t n);
+
+/* Fused operations, each converting to a ubound once at the end */
+void fmau(ubnd_s *a, const ubnd_s *x, const ubnd_s *y, const ubnd_s *z);
+void fdotu(ubnd_s *a, const ubnd_s *x, const ubnd_s *y, size_t n);
+void fsumu(ubnd_s *a, const ubnd_s *u, size_t n);
+void fprodu(ubnd_s *a, const ubnd_s *u, size_t n);
+void fprodratiou(ubnd_s *a, const ubnd_s *num, size_t nnum, const ubnd_s *den, size_t nden);
+
 void powu(ubnd_s *a, const ubnd_s *u, const ubnd_s *v);
 void squareu(ubnd_s *a, const ubnd_s *u);
 void sqrtu(ubnd_s *a, const ubnd_s *u);
@@ -0,0 +1,525 @@
+/*
+ * Copyright (c) 2016, Lawrence Livermore National Security, LLC. 
+ * Produced at the Lawrence Livermore National Laboratory. Written by
+ * G. Scott Lloyd, lloyd23@llnl.gov. LLNL-CODE-704762. All rights reserved.
+ * 
+ * This file is part of Unum. For details, see
+ * http://github.com/LLNL/unum
+ * 
+ * Please also read COPYING  Our Notice and GNU Lesser General Public 
+ * License. 
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License (as published by the 
+ * Free Software Foundation) version 2.1 dated February 1999. 
+ * 
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and 
+ * conditions of the GNU General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU Lesser General Public License 
+ * along with this program; if not, write to the Free Software Foundation, 
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#include <stdlib.h> /* labs */
+
+#include "ubnd64.h"
+#include "uenv.h"
+#include "conv.h" /* roundu */
+
+#if defined(HAVE_UBND64)
+
+/* Native engine for environments with maxubits <= 64. Exact operands
+   are decoded into integers, combined exactly, and encoded with the
+   same rules as f2u(). Anything that is not exact in 128 bits is left
+   to the g-layer so results stay identical to the GMP path. */
+
+typedef unsigned __int128 u128_t;
+
+/* Environment values as native words, from the env64_s env in scope */
+#define UBIT64   (1UL << (env->utagsize-1))
+#define FMASK64  ((1UL << env->fsizesize) - 1)
+#define EMASK64  (((1UL << env->esizesize) - 1) << env->fsizesize)
+#define UTAG64   ((1UL << env->utagsize) - 1)
+#define ULP64    (1UL << env->utagsize)
+#define SIGN64   (1UL << (env->maxubits-1))
+#define POSINF64 (SIGN64 - 1 - UBIT64)
+#define NEGINF64 (POSINF64 | SIGN64)
+#define QNAN64   (POSINF64 + UBIT64)
+#define SNAN64   (NEGINF64 + UBIT64)
+
+/* Native endpoint: value is (-1)^neg * m * 2^e, or +-Inf if inf. */
+typedef struct {
+	unsigned long m;
+	long e;
+	unsigned int neg : 1;
+	unsigned int open : 1;
+	unsigned int inf : 1;
+} gn64_s;
+
+typedef struct {
+	gn64_s l;
+	gn64_s r;
+	unsigned int nan : 1;
+} gb64_s;
+
+static int bitlen64(unsigned long x)
+{
+	return (x) ? 64 - __builtin_clzl(x) : 0;
+}
+
+static int bitlen128(u128_t x)
+{
+	unsigned long hi = (unsigned long)(x >> 64);
+	return (hi) ? 128 - __builtin_clzl(hi) : bitlen64((unsigned long)x);
+}
+
+static int ctz128(u128_t x)
+{
+	unsigned long lo = (unsigned long)x;
+	return (lo) ? __builtin_ctzl(lo) : 64 + __builtin_ctzl((unsigned long)(x >> 64));
+}
+
+/* Same as ne() in support.c, given the scale factor. */
+
+static int ne64(long sf)
+{
+	long tmp;
+	int nb;
+
+	if (sf == 1) return 1;
+	tmp = labs(sf-1)+1;
+	for (nb = 0, tmp--; tmp; tmp >>= 1, nb++) ;
+	return(nb+1);
+}
+
+/* Decode the value of a unum, ignoring the ubit (see u2f). */
+
+static void u2f64(const env64_s *env, gn64_s *a, unsigned long u)
+{
+	int fs = (u & FMASK64) + 1;
+	int es = ((u & EMASK64) >> env->fsizesize) + 1;
+	long bias = (1L << (es-1)) - 1;
+	unsigned long expo = (u >> (fs + env->utagsize)) & ((1UL << es) - 1);
+	unsigned long frac = (u >> env->utagsize) & ((1UL << fs) - 1);
+
+	if (expo) {
+		a->m = frac | (1UL << fs);
+		a->e = (long)expo - bias - fs;
+	} else {
+		a->m = frac;
+		a->e = 1 - bias - fs;
+	}
+	a->neg = (a->m) ? (u >> (es + fs + env->utagsize)) & 1 : 0;
+	a->inf = 0;
+}
+
+/* Encode (-1)^neg * m * 2^e as a unum, following f2u() case by case. */
+
+static unsigned long f2u64(const env64_s *env, int neg, u128_t m, long e)
+{
+	long bias = (1L << (env->esizemax-1)) - 1;
+	long sf;
+	int bl, fs, tz;
+	unsigned long u;
+
+	/* Zero is a special case. */
+	if (m == 0) return 0;
+	tz = ctz128(m);
+	m >>= tz;
+	e += tz;
+	bl = bitlen128(m);
+	sf = e + bl - 1;
+	/* Magnitudes too large to represent: */
+	if (sf > bias+1 || (sf == bias+1 && bl > env->fsizemax &&
+		(m >> (bl - env->fsizemax)) == (((u128_t)1 << env->fsizemax) - 1))) {
+		u = POSINF64 - ULP64 + UBIT64;
+		return (neg) ? u | SIGN64 : u;
+	}
+	/* Magnitudes too small to represent: */
+	if (sf < 1 - bias - env->fsizemax) {
+		return (neg) ? UTAG64 | SIGN64 : UTAG64;
+	}
+	/* Subnormal numbers */
+	if (sf < 1 - bias) {
+		unsigned long efbits = FMASK64 | EMASK64;
+		int spos = env->maxubits-1;
+		long q = e - (1 - bias - env->fsizemax);
+		if (q >= 0) {
+			u = (unsigned long)m; /* trailing zero bits stripped */
+			efbits -= q;
+			spos -= q;
+			u = (u << env->utagsize) + efbits;
+		} else {
+			u = (unsigned long)(m >> -q);
+			u = (u << env->utagsize) + efbits + UBIT64;
+		}
+		return (neg) ? u | (1UL << spos) : u;
+	}
+	/* If a number is more concise as a subnormal, make it one. */
+	if (m == 1 && sf <= 0) {
+		int es, pc;
+		long tmp;
+		for (es = pc = 0, tmp = 1-sf; tmp; tmp >>= 1, es++) if (tmp & 1) pc++;
+		if (pc == 1) {
+			u = ((unsigned long)(es-1) << env->fsizesize) | ULP64;
+			return (neg) ? u | (1UL << (es+1+env->utagsize)) : u;
+		}
+	}
+	fs = bl - 1;
+	if (fs <= env->fsizemax) {
+		/* Exact */
+		int nef = ne64(sf);
+		int fb = (fs > 0) ? fs : 1;
+		u = (fs - ((fs > 0) ? 1 : 0)) | ((unsigned long)(nef-1) << env->fsizesize);
+		if (fs > 0) u |= ((unsigned long)m - (1UL << fs)) << env->utagsize;
+		u |= (unsigned long)(sf + (1L << (nef-1)) - 1) << (env->utagsize + fb);
+		if (neg) u |= 1UL << (env->utagsize + fb + nef);
+	} else {
+		/* Inexact, round the magnitude up to a full fraction and back off one ULP. */
+		u128_t c = (m >> (fs - env->fsizemax)) + 1;
+		long s1 = sf;
+		int nef, ne1, ne2;
+		if (c >> (env->fsizemax+1)) {
+			c >>= 1;
+			s1++;
+		}
+		nef = ne64(sf);
+		ne1 = ne64(s1);
+		ne2 = (nef > ne1) ? nef : ne1;
+		u = FMASK64 | ((unsigned long)(ne2-1) << env->fsizesize) | UBIT64;
+		u |= ((unsigned long)c - (1UL << env->fsizemax)) << env->utagsize;
+		u |= (unsigned long)(s1 + (1L << (ne2-1)) - 1) << (env->utagsize + env->fsizemax);
+		u -= ULP64;
+		if (neg) u |= 1UL << (env->utagsize + env->fsizemax + ne2);
+	}
+	return u;
+}
+
+/* Store an exact result as a single unum, like g2u() does for [x, x]. */
+
+static int put64(const env64_s *env, ubnd_s *a, int neg, u128_t m, long e)
+{
+	a->p = 0;
+#if defined(USE_MPN)
+	/* not mpx_set_ui, which clears the limbs of the thread's environment */
+	a->l[0] = f2u64(env, neg, m, e);
+#else
+	mpx_set_ui(a->l, f2u64(env, neg, m, e));
+#endif
+#if defined(ROUND)
+	roundu(a->l);
+#endif
+#if defined(USE_MPN)
+	a->r[0] = a->l[0];
+#else
+	mpx_set(a->r, a->l);
+#endif
+	return 1;
+}
+
+/* Decode a ubound that is a single, exact, finite unum. */
+
+static int exact64(const env64_s *env, gn64_s *a, const ubnd_s *ub)
+{
+	unsigned long u;
+
+	if (ub->p) return 0;
+	u = mpx_get_ui(ub->l);
+	if ((u & UBIT64) || (u & ~SIGN64) == POSINF64) return 0;
+	u2f64(env, a, u);
+	return 1;
+}
+
+/* Conversion of a unum to a native interval, see unum2g(). */
+
+static void unum2g64(const env64_s *env, gb64_s *a, unsigned long u)
+{
+	int fs, es, signpos;
+	unsigned long big;
+
+	a->nan = 0;
+	if (u == QNAN64 || u == SNAN64) {
+		a->nan = 1;
+		a->l.m = a->r.m = 0;
+		a->l.e = a->r.e = 0;
+		a->l.neg = a->r.neg = 0;
+		a->l.inf = a->r.inf = 0;
+		a->l.open = a->r.open = 1;
+		return;
+	}
+	if ((u & ~SIGN64) == POSINF64) {
+		a->l.neg = a->r.neg = (u & SIGN64) != 0;
+		a->l.m = a->r.m = 1;
+		a->l.e = a->r.e = 0;
+		a->l.inf = a->r.inf = 1;
+		a->l.open = a->r.open = 0;
+		return;
+	}
+	if (!(u & UBIT64)) {
+		u2f64(env, &a->l, u);
+		a->r = a->l;
+		a->l.open = a->r.open = 0;
+		return;
+	}
+	/* open */
+	fs = (u & FMASK64) + 1;
+	es = ((u & EMASK64) >> env->fsizesize) + 1;
+	signpos = es + fs + env->utagsize;
+	big = (1UL << signpos) - ULP64;
+	if (es == env->esizemax && fs == env->fsizemax) big -= ULP64;
+	big += (u & (FMASK64 | EMASK64)) | UBIT64;
+	if (u == big) { /* (bigu, Inf) */
+		u2f64(env, &a->l, u);
+		a->r.m = 1; a->r.e = 0; a->r.neg = 0;
+		a->l.inf = 0; a->r.inf = 1;
+	} else if (u == (big | (1UL << signpos))) { /* (-Inf, -bigu) */
+		u2f64(env, &a->r, u);
+		a->l.m = 1; a->l.e = 0; a->l.neg = 1;
+		a->l.inf = 1; a->r.inf = 0;
+	} else if (u & (1UL << signpos)) { /* (-(x+ulp), -x) */
+		u2f64(env, &a->l, u + ULP64);
+		u2f64(env, &a->r, u);
+	} else { /* (x, x+ulp) */
+		u2f64(env, &a->l, u);
+		u2f64(env, &a->r, u + ULP64);
+	}
+	a->l.open = a->r.open = 1;
+}
+
+/* Conversion of a unum or ubound to a native interval, see u2g(). */
+
+static void u2g64(const env64_s *env, gb64_s *a, const ubnd_s *ub)
+{
+	gb64_s gR;
+
+	unum2g64(env, a, mpx_get_ui(ub->l));
+	if (!ub->p) return;
+	unum2g64(env, &gR, mpx_get_ui(ub->r));
+	if (a->nan || gR.nan) {
+		unum2g64(env, a, QNAN64);
+		return;
+	}
+	a->r = gR.r;
+}
+
+/* Compare finite values, like mpf_cmp(). */
+
+static int cmpf64(const gn64_s *x, const gn64_s *y)
+{
+	int sx = (x->m) ? ((x->neg) ? -1 : 1) : 0;
+	int sy = (y->m) ? ((y->neg) ? -1 : 1) : 0;
+	int bx, by;
+
+	if (sx != sy) return (sx > sy) ? 1 : -1;
+	if (sx == 0) return 0;
+	bx = bitlen64(x->m);
+	by = bitlen64(y->m);
+	if (bx + x->e != by + y->e) return (bx + x->e > by + y->e) ? sx : -sx;
+	{
+		unsigned long mx = x->m << (64 - bx);
+		unsigned long my = y->m << (64 - by);
+		if (mx == my) return 0;
+		return (mx > my) ? sx : -sx;
+	}
+}
+
+/* Compare values of endpoints, infinities included. */
+
+static int cmpv64(const gn64_s *x, const gn64_s *y)
+{
+	if (x->inf || y->inf) {
+		int sx = (x->neg) ? -1 : 1;
+		int sy = (y->neg) ? -1 : 1;
+		if (x->inf && !y->inf) return sx;
+		if (!x->inf && y->inf) return -sy;
+		return (sx > sy) - (sx < sy);
+	}
+	return cmpf64(x, y);
+}
+
+/* Comparison of interval end points, see cmp_gn() in glayer.h */
+
+static int cmp_gn64(const gn64_s *x, end_t xe, const gn64_s *y, end_t ye)
+{
+	int res;
+
+	if ((res = cmpv64(x, y)) != 0) return res;
+	return ((x->open)?xe:1) - ((y->open)?ye:1);
+}
+
+static int ltg64(const gb64_s *g, const gb64_s *h)
+{
+	return !(g->nan || h->nan) && cmp_gn64(&g->r, RE, &h->l, LE) < 0;
+}
+
+static int gtg64(const gb64_s *g, const gb64_s *h)
+{
+	return !(g->nan || h->nan) && cmp_gn64(&g->l, LE, &h->r, RE) > 0;
+}
+
+int ltuQ64(const env64_s *env, const ubnd_s *u, const ubnd_s *v)
+{
+	gb64_s g, h;
+
+	u2g64(env, &g, u);
+	u2g64(env, &h, v);
+	return ltg64(&g, &h);
+}
+
+int gtuQ64(const env64_s *env, const ubnd_s *u, const ubnd_s *v)
+{
+	gb64_s g, h;
+
+	u2g64(env, &g, u);
+	u2g64(env, &h, v);
+	return gtg64(&g, &h);
+}
+
+int nequQ64(const env64_s *env, const ubnd_s *u, const ubnd_s *v)
+{
+	gb64_s g, h;
+
+	u2g64(env, &g, u);
+	u2g64(env, &h, v);
+	return !(g.nan || h.nan) && (ltg64(&g, &h) || gtg64(&g, &h));
+}
+
+int nnequQ64(const env64_s *env, const ubnd_s *u, const ubnd_s *v)
+{
+	gb64_s g, h;
+
+	u2g64(env, &g, u);
+	u2g64(env, &h, v);
+	return !(g.nan || h.nan) && !(ltg64(&g, &h) || gtg64(&g, &h));
+}
+
+int sameuQ64(const env64_s *env, const ubnd_s *u, const ubnd_s *v)
+{
+	gb64_s g, h;
+
+	u2g64(env, &g, u);
+	u2g64(env, &h, v);
+	return (g.nan && h.nan) ||
+		(
+			g.nan == h.nan &&
+			cmpv64(&g.l, &h.l) == 0 &&
+			g.l.inf == h.l.inf &&
+			g.l.open == h.l.open &&
+			cmpv64(&g.r, &h.r) == 0 &&
+			g.r.inf == h.r.inf &&
+			g.r.open == h.r.open
+		);
+}
+
+int cmpuQ64(const env64_s *env, const ubnd_s *u, end_t ue, const ubnd_s *v, end_t ve)
+{
+	gb64_s g, h;
+
+	u2g64(env, &g, u);
+	u2g64(env, &h, v);
+	if (g.nan || h.nan) return 0;
+	return cmp_gn64(ue==LE ? &g.l : &g.r, ue, ve==LE ? &h.l : &h.r, ve);
+}
+
+int spanszerouQ64(const env64_s *env, const ubnd_s *u)
+{
+	gb64_s g;
+	int sl, sr;
+
+	u2g64(env, &g, u);
+	sl = (g.l.m) ? ((g.l.neg) ? -1 : 1) : 0;
+	sr = (g.r.m) ? ((g.r.neg) ? -1 : 1) : 0;
+	return (!sl && !g.l.open) || (!sr && !g.r.open) || (sl < 0 && sr > 0);
+}
+
+/* Sum of exact values. Falls back if the aligned sum needs over 127 bits. */
+
+static int add64(const env64_s *env, ubnd_s *a, const gn64_s *x, const gn64_s *y)
+{
+	u128_t mx, my;
+	long d;
+
+	if (!x->m) return put64(env, a, y->neg, y->m, y->e);
+	if (!y->m) return put64(env, a, x->neg, x->m, x->e);
+	if (x->e > y->e) {const gn64_s *t = x; x = y; y = t;}
+	d = y->e - x->e;
+	if (d + bitlen64(y->m) > 126) return 0;
+	mx = x->m;
+	my = (u128_t)y->m << d;
+	if (x->neg == y->neg) return put64(env, a, x->neg, mx + my, x->e);
+	if (mx >= my) return put64(env, a, x->neg, mx - my, x->e);
+	return put64(env, a, y->neg, my - mx, x->e);
+}
+
+int plusu64(const env64_s *env, ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
+{
+	gn64_s x, y;
+
+	if (!exact64(env, &x, u) || !exact64(env, &y, v)) return 0;
+	return add64(env, a, &x, &y);
+}
+
+int minusu64(const env64_s *env, ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
+{
+	gn64_s x, y;
+
+	if (!exact64(env, &x, u) || !exact64(env, &y, v)) return 0;
+	if (y.m) y.neg = !y.neg;
+	return add64(env, a, &x, &y);
+}
+
+int timesu64(const env64_s *env, ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
+{
+	gn64_s x, y;
+
+	if (!exact64(env, &x, u) || !exact64(env, &y, v)) return 0;
+	return put64(env, a, x.neg ^ y.neg, (u128_t)x.m * y.m, x.e + y.e);
+}
+
+/* Quotient of exact values, only when it is exact. */
+
+int divideu64(const env64_s *env, ubnd_s *a, const ubnd_s *u, const ubnd_s *v)
+{
+	gn64_s x, y;
+	int tz;
+
+	if (!exact64(env, &x, u) || !exact64(env, &y, v) || !y.m) return 0;
+	tz = __builtin_ctzl(y.m);
+	y.m >>= tz;
+	if (x.m % y.m) return 0;
+	return put64(env, a, x.neg ^ y.neg, x.m / y.m, x.e - y.e - tz);
+}
+
+int squareu64(const env64_s *env, ubnd_s *a, const ubnd_s *u)
+{
+	gn64_s x;
+
+	if (!exact64(env, &x, u)) return 0;
+	return put64(env, a, 0, (u128_t)x.m * x.m, 2 * x.e);
+}
+
+/* Square root of exact values, only when it is exact. */
+
+int sqrtu64(const env64_s *env, ubnd_s *a, const ubnd_s *u)
+{
+	gn64_s x;
+	unsigned long r;
+
+	if (!exact64(env, &x, u) || x.neg) return 0;
+	if (x.e & 1) {
+		x.m <<= 1;
+		x.e--;
+	}
+	/* Newton's method from above, the value has at most 35 bits. */
+	if (x.m) {
+		unsigned long s = 1UL << ((bitlen64(x.m) + 1) / 2);
+		do {r = s; s = (r + x.m / r) / 2;} while (s < r);
+	} else r = 0;
+	if (r * r != x.m) return 0;
+	return put64(env, a, 0, r, x.e / 2);
+}
+
+#endif /* HAVE_UBND64 */
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2016, Lawrence Livermore National Security, LLC. 
+ * Produced at the Lawrence Livermore National Laboratory. Written by
+ * G. Scott Lloyd, lloyd23@llnl.gov. LLNL-CODE-704762. All rights reserved.
+ * 
+ * This file is part of Unum. For details, see
+ * http://github.com/LLNL/unum
+ * 
+ * Please also read COPYING  Our Notice and GNU Lesser General Public 
+ * License. 
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License (as published by the 
+ * Free Software Foundation) version 2.1 dated February 1999. 
+ * 
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and 
+ * conditions of the GNU General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU Lesser General Public License 
+ * along with this program; if not, write to the Free Software Foundation, 
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#ifndef UBND64_H_
+#define UBND64_H_
+
+#include "ulayer.h" /* ubnd_s */
+#include "glayer.h" /* end_t */
+
+/* The native engine keeps a whole unum in one 64-bit word and the
+   exact intermediate results of the g-layer in 128-bit integers. */
+#if defined(__SIZEOF_INT128__) && __SIZEOF_LONG__ == 8 && GMP_NUMB_BITS == 64
+#define HAVE_UBND64 1
+#endif
+
+/* Largest environment handled by the native engine, see uenv64. */
+#define UBND64_MAX_UBITS 64
+
+/* The sizes of the environment the native engine works in, passed to each
+   function, so an environment known to the caller need not be made the
+   thread's. With USE_MPN a unum of such an environment is one limb. */
+typedef struct {
+	int esizesize, fsizesize, esizemax, fsizemax, utagsize, maxubits;
+} env64_s;
+
+/* The thread's environment as an env64_s, see uenv.h. */
+#define ENV64_VAR(name) \
+	const env64_s name = {esizesize, fsizesize, esizemax, fsizemax, utagsize, maxubits}
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+int ltuQ64(const env64_s *env, const ubnd_s *u, const ubnd_s *v);
+int gtuQ64(const env64_s *env, const ubnd_s *u, const ubnd_s *v);
+int nequQ64(const env64_s *env, const ubnd_s *u, const ubnd_s *v);
+int nnequQ64(const env64_s *env, const ubnd_s *u, const ubnd_s *v);
+int sameuQ64(const env64_s *env, const ubnd_s *u, const ubnd_s *v);
+int cmpuQ64(const env64_s *env, const ubnd_s *u, end_t ue, const ubnd_s *v, end_t ve);
+int spanszerouQ64(const env64_s *env, const ubnd_s *u);
+
+/* Return nonzero if the result was computed, zero to use the g-layer. */
+int plusu64(const env64_s *env, ubnd_s *a, const ubnd_s *u, const ubnd_s *v);
+int minusu64(const env64_s *env, ubnd_s *a, const ubnd_s *u, const ubnd_s *v);
+int timesu64(const env64_s *env, ubnd_s *a, const ubnd_s *u, const ubnd_s *v);
+int divideu64(const env64_s *env, ubnd_s *a, const ubnd_s *u, const ubnd_s *v);
+int squareu64(const env64_s *env, ubnd_s *a, const ubnd_s *u);
+int sqrtu64(const env64_s *env, ubnd_s *a, const ubnd_s *u);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* UBND64_H_ */
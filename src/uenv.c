@@ -27,172 +27,336 @@
 #include <stdlib.h> /* exit */
 
 #include "uenv.h"
+#include "ubnd64.h" /* HAVE_UBND64 */
 
-int esizesize;
-int fsizesize;
-int esizemax;
-int fsizemax;
-int utagsize;
-int maxubits;
-
-mp_size_t ulimbs;
-mp_size_t plimbs;
-mp_bitcnt_t pbits;
-
-mpx_t one;
-mpx_t ubitmask;
-mpx_t fsizemask;
-mpx_t esizemask;
-mpx_t efsizemask;
-mpx_t utagmask;
-mpx_t ulpu;
-mpx_t smallsubnormalu;
-mpx_t smallnormalu;
-mpx_t signbigu;
-mpx_t posinfu;
-mpx_t maxrealu;
-mpx_t minrealu;
-mpx_t neginfu;
-mpx_t negbigu;
-mpx_t qNaNu;
-mpx_t sNaNu;
-mpx_t negopeninfu;
-mpx_t posopeninfu;
-mpx_t negopenzerou;
-
-mpf_t maxreal;
-mpf_t smallsubnormal;
-
-static int initialized;
+UNUM_TLS int esizesize;
+UNUM_TLS int fsizesize;
+UNUM_TLS int esizemax;
+UNUM_TLS int fsizemax;
+UNUM_TLS int utagsize;
+UNUM_TLS int maxubits;
+
+UNUM_TLS int uenv64;
+
+UNUM_TLS mp_size_t ulimbs;
+UNUM_TLS mp_size_t plimbs;
+UNUM_TLS mp_bitcnt_t pbits;
+
+UNUM_TLS mpx_srcptr one;
+UNUM_TLS mpx_srcptr ubitmask;
+UNUM_TLS mpx_srcptr fsizemask;
+UNUM_TLS mpx_srcptr esizemask;
+UNUM_TLS mpx_srcptr efsizemask;
+UNUM_TLS mpx_srcptr utagmask;
+UNUM_TLS mpx_srcptr ulpu;
+UNUM_TLS mpx_srcptr smallsubnormalu;
+UNUM_TLS mpx_srcptr smallnormalu;
+UNUM_TLS mpx_srcptr signbigu;
+UNUM_TLS mpx_srcptr posinfu;
+UNUM_TLS mpx_srcptr maxrealu;
+UNUM_TLS mpx_srcptr minrealu;
+UNUM_TLS mpx_srcptr neginfu;
+UNUM_TLS mpx_srcptr negbigu;
+UNUM_TLS mpx_srcptr qNaNu;
+UNUM_TLS mpx_srcptr sNaNu;
+UNUM_TLS mpx_srcptr negopeninfu;
+UNUM_TLS mpx_srcptr posopeninfu;
+UNUM_TLS mpx_srcptr negopenzerou;
+
+UNUM_TLS mpf_srcptr maxreal;
+UNUM_TLS mpf_srcptr negmaxreal;
+UNUM_TLS mpf_srcptr smallsubnormal;
+
+UNUM_TLS const gbnd_s *zerog;
+UNUM_TLS const gbnd_s *oneg;
+UNUM_TLS const gbnd_s *twog;
+UNUM_TLS const gbnd_s *threeg;
+UNUM_TLS const gbnd_s *maxrealg;
+
+/* An environment computed once by find_uenv and never changed after. */
+struct uenv_s {
+	int esizesize, fsizesize, esizemax, fsizemax, utagsize, maxubits, uenv64;
+	mp_size_t ulimbs, plimbs;
+	mp_bitcnt_t pbits;
+
+	mpx_t one, ubitmask, fsizemask, esizemask, efsizemask, utagmask, ulpu;
+	mpx_t smallsubnormalu, smallnormalu, signbigu, posinfu, maxrealu;
+	mpx_t minrealu, neginfu, negbigu, qNaNu, sNaNu;
+	mpx_t negopeninfu, posopeninfu, negopenzerou;
+
+	mpf_t maxreal, negmaxreal, smallsubnormal;
+
+	gbnd_s zerog, oneg, twog, threeg, maxrealg;
+};
+
+/* Environments built by this thread, see clear_uenv. */
+static UNUM_TLS uenv_s *cache[MAX_ESIZESIZE+1][MAX_FSIZESIZE+1];
+static UNUM_TLS const uenv_s *current;
 
 
 void init_uenv(void)
 {
-	mpx_init2(one, MAX_UBITS);
-	mpx_init2(ubitmask, MAX_UBITS);
-	mpx_init2(fsizemask, MAX_UBITS);
-	mpx_init2(esizemask, MAX_UBITS);
-	mpx_init2(efsizemask, MAX_UBITS);
-	mpx_init2(utagmask, MAX_UBITS);
-	mpx_init2(ulpu, MAX_UBITS);
-	mpx_init2(smallsubnormalu, MAX_UBITS);
-	mpx_init2(smallnormalu, MAX_UBITS);
-	mpx_init2(signbigu, MAX_UBITS);
-	mpx_init2(posinfu, MAX_UBITS);
-	mpx_init2(maxrealu, MAX_UBITS);
-	mpx_init2(minrealu, MAX_UBITS);
-	mpx_init2(neginfu, MAX_UBITS);
-	mpx_init2(negbigu, MAX_UBITS);
-	mpx_init2(qNaNu, MAX_UBITS);
-	mpx_init2(sNaNu, MAX_UBITS);
-	mpx_init2(negopeninfu, MAX_UBITS);
-	mpx_init2(posopeninfu, MAX_UBITS);
-	mpx_init2(negopenzerou, MAX_UBITS);
-
-	mpf_init2(maxreal, MAX_PBITS);
-	mpf_init2(smallsubnormal, MAX_PBITS);
-
-	initialized = 1;
+	/* environments are built on demand by find_uenv */
+}
+
+/* An exact closed gbound of f. Its limbs come from the mpf functions,
+   not the scratch pool, since it lives as long as the environment. */
+
+static void init_const(gbnd_s *g, const mpf_t f)
+{
+	mpf_init2(g->l.f, mpf_get_prec(f));
+	mpf_init2(g->r.f, mpf_get_prec(f));
+	mpf_set(g->l.f, f);
+	mpf_set(g->r.f, f);
+	g->l.inf = g->r.inf = 0;
+	g->l.open = g->r.open = 0;
+	g->nan = 0;
+}
+
+static void clear_const(gbnd_s *g)
+{
+	mpf_clear(g->l.f);
+	mpf_clear(g->r.f);
+}
+
+static void free_uenv(uenv_s *env)
+{
+	mpx_clear(env->one);
+	mpx_clear(env->ubitmask);
+	mpx_clear(env->fsizemask);
+	mpx_clear(env->esizemask);
+	mpx_clear(env->efsizemask);
+	mpx_clear(env->utagmask);
+	mpx_clear(env->ulpu);
+	mpx_clear(env->smallsubnormalu);
+	mpx_clear(env->smallnormalu);
+	mpx_clear(env->signbigu);
+	mpx_clear(env->posinfu);
+	mpx_clear(env->maxrealu);
+	mpx_clear(env->minrealu);
+	mpx_clear(env->neginfu);
+	mpx_clear(env->negbigu);
+	mpx_clear(env->qNaNu);
+	mpx_clear(env->sNaNu);
+	mpx_clear(env->negopeninfu);
+	mpx_clear(env->posopeninfu);
+	mpx_clear(env->negopenzerou);
+
+	mpf_clear(env->maxreal);
+	mpf_clear(env->negmaxreal);
+	mpf_clear(env->smallsubnormal);
+
+	clear_const(&env->zerog);
+	clear_const(&env->oneg);
+	clear_const(&env->twog);
+	clear_const(&env->threeg);
+	clear_const(&env->maxrealg);
+
+	free(env);
 }
 
 void clear_uenv(void)
 {
-	mpx_clear(one);
-	mpx_clear(ubitmask);
-	mpx_clear(fsizemask);
-	mpx_clear(esizemask);
-	mpx_clear(efsizemask);
-	mpx_clear(utagmask);
-	mpx_clear(ulpu);
-	mpx_clear(smallsubnormalu);
-	mpx_clear(smallnormalu);
-	mpx_clear(signbigu);
-	mpx_clear(posinfu);
-	mpx_clear(maxrealu);
-	mpx_clear(minrealu);
-	mpx_clear(neginfu);
-	mpx_clear(negbigu);
-	mpx_clear(qNaNu);
-	mpx_clear(sNaNu);
-	mpx_clear(negopeninfu);
-	mpx_clear(posopeninfu);
-	mpx_clear(negopenzerou);
-
-	mpf_clear(maxreal);
-	mpf_clear(smallsubnormal);
-
-	initialized = 0;
+	int e, f;
+
+	for (e = 0; e <= (int)MAX_ESIZESIZE; e++)
+		for (f = 0; f <= (int)MAX_FSIZESIZE; f++)
+			if (cache[e][f]) {free_uenv(cache[e][f]); cache[e][f] = NULL;}
+	current = NULL;
+	one = NULL;
+
+	ulimbs = 0; /* no environment */
 }
 
-/* Set the environment variables based on esizesize and fsizesize.
-   Here, maximum esizesize is MAX_ESIZESIZE
-   and maximum fsizesize is MAX_FSIZESIZE. */
+/* Compute the environment variables based on esizesize and fsizesize. */
 
-void set_uenv(int e, int f)
+static uenv_s *make_uenv(int e, int f)
 {
-	if (!initialized) init_uenv();
-	if (e < 0 || e > MAX_ESIZESIZE || f < 0 || f > MAX_FSIZESIZE) {
-		fprintf(stderr, " -- error: exponent size size or fraction size size out of range\n");
-		fprintf(stderr, " -- max exponent size size: %u\n", MAX_ESIZESIZE);
-		fprintf(stderr, " -- max fraction size size: %u\n", MAX_FSIZESIZE);
+	uenv_s *env = (uenv_s *)malloc(sizeof(uenv_s));
+	int esizemax, utagsize, maxubits;
+	mp_size_t ulimbs; /* NLIMBS for the mpn build, the thread's is left alone */
+
+	if (env == NULL) {
+		fprintf(stderr, " -- error: out of memory for environment\n");
 		exit(EXIT_FAILURE);
 	}
 
 	/* integer type */
-	esizesize = e;
-	fsizesize = f;
-	esizemax = 1 << e;
-	fsizemax = 1 << f;
-	utagsize = 1 + e + f;
-	maxubits = 1 + esizemax + fsizemax + utagsize;
-	ulimbs = MPX_BITS2LIMBS(maxubits);
-	pbits = FSIZE2PREC(fsizemax);
-	plimbs = MPF_BITS2LIMBS(pbits);
+	env->esizesize = e;
+	env->fsizesize = f;
+	env->esizemax = esizemax = 1 << e;
+	env->fsizemax = 1 << f;
+	env->utagsize = utagsize = 1 + e + f;
+	env->maxubits = maxubits = 1 + esizemax + env->fsizemax + utagsize;
+	env->ulimbs = ulimbs = MPX_BITS2LIMBS(maxubits);
+	env->pbits = FSIZE2PREC(env->fsizemax);
+	env->plimbs = MPF_BITS2LIMBS(env->pbits);
+#if defined(HAVE_UBND64)
+	env->uenv64 = maxubits <= UBND64_MAX_UBITS;
+#else
+	env->uenv64 = 0;
+#endif
 
 	/* unum type */
-	mpx_set_ui(one, 1);
-	mpx_lshift(ubitmask, one, utagsize-1);
-	mpx_lshift(fsizemask, one, f);
-		mpx_sub_ui(fsizemask, fsizemask, 1);
-	mpx_sub_ui(esizemask, ubitmask, 1);
-		mpx_sub(esizemask, esizemask, fsizemask);
-	mpx_ior(efsizemask, esizemask, fsizemask);
-	mpx_ior(utagmask, ubitmask, efsizemask);
-	mpx_lshift(ulpu, one, utagsize);
-	mpx_add(smallsubnormalu, efsizemask, ulpu);
+	mpx_init2(env->one, maxubits);
+	mpx_init2(env->ubitmask, maxubits);
+	mpx_init2(env->fsizemask, maxubits);
+	mpx_init2(env->esizemask, maxubits);
+	mpx_init2(env->efsizemask, maxubits);
+	mpx_init2(env->utagmask, maxubits);
+	mpx_init2(env->ulpu, maxubits);
+	mpx_init2(env->smallsubnormalu, maxubits);
+	mpx_init2(env->smallnormalu, maxubits);
+	mpx_init2(env->signbigu, maxubits);
+	mpx_init2(env->posinfu, maxubits);
+	mpx_init2(env->maxrealu, maxubits);
+	mpx_init2(env->minrealu, maxubits);
+	mpx_init2(env->neginfu, maxubits);
+	mpx_init2(env->negbigu, maxubits);
+	mpx_init2(env->qNaNu, maxubits);
+	mpx_init2(env->sNaNu, maxubits);
+	mpx_init2(env->negopeninfu, maxubits);
+	mpx_init2(env->posopeninfu, maxubits);
+	mpx_init2(env->negopenzerou, maxubits);
+
+	mpx_set_ui(env->one, 1);
+	mpx_lshift(env->ubitmask, env->one, utagsize-1);
+	mpx_lshift(env->fsizemask, env->one, f);
+		mpx_sub_ui(env->fsizemask, env->fsizemask, 1);
+	mpx_sub_ui(env->esizemask, env->ubitmask, 1);
+		mpx_sub(env->esizemask, env->esizemask, env->fsizemask);
+	mpx_ior(env->efsizemask, env->esizemask, env->fsizemask);
+	mpx_ior(env->utagmask, env->ubitmask, env->efsizemask);
+	mpx_lshift(env->ulpu, env->one, utagsize);
+	mpx_add(env->smallsubnormalu, env->efsizemask, env->ulpu);
 	/* Proto difference: smallnormalu is in reduced form here. */
-	mpx_lshift(smallnormalu, one, utagsize+1);
-		mpx_ior(smallnormalu, smallnormalu, esizemask);
-	mpx_lshift(signbigu, one, maxubits-1);
-	mpx_sub_ui(posinfu, signbigu, 1);
-		mpx_sub(posinfu, posinfu, ubitmask);
-	mpx_sub(maxrealu, posinfu, ulpu);
-	mpx_add(minrealu, maxrealu, signbigu);
-	mpx_add(neginfu, posinfu, signbigu);
-	mpx_sub(negbigu, neginfu, ulpu);
-	mpx_add(qNaNu, posinfu, ubitmask);
-	mpx_add(sNaNu, neginfu, ubitmask);
+	mpx_lshift(env->smallnormalu, env->one, utagsize+1);
+		mpx_ior(env->smallnormalu, env->smallnormalu, env->esizemask);
+	mpx_lshift(env->signbigu, env->one, maxubits-1);
+	mpx_sub_ui(env->posinfu, env->signbigu, 1);
+		mpx_sub(env->posinfu, env->posinfu, env->ubitmask);
+	mpx_sub(env->maxrealu, env->posinfu, env->ulpu);
+	mpx_add(env->minrealu, env->maxrealu, env->signbigu);
+	mpx_add(env->neginfu, env->posinfu, env->signbigu);
+	mpx_sub(env->negbigu, env->neginfu, env->ulpu);
+	mpx_add(env->qNaNu, env->posinfu, env->ubitmask);
+	mpx_add(env->sNaNu, env->neginfu, env->ubitmask);
 	if (utagsize == 1) {
-		mpx_set_ui(negopeninfu, 0xD);
+		mpx_set_ui(env->negopeninfu, 0xD);
 	} else {
-		mpx_set_ui(negopeninfu, 0xF);
-		mpx_lshift(negopeninfu, negopeninfu, utagsize-1);
+		mpx_set_ui(env->negopeninfu, 0xF);
+		mpx_lshift(env->negopeninfu, env->negopeninfu, utagsize-1);
 	}
 	if (utagsize == 1) {
-		mpx_set_ui(posopeninfu, 0x5);
+		mpx_set_ui(env->posopeninfu, 0x5);
 	} else {
-		mpx_set_ui(posopeninfu, 0x7);
-		mpx_lshift(posopeninfu, posopeninfu, utagsize-1);
+		mpx_set_ui(env->posopeninfu, 0x7);
+		mpx_lshift(env->posopeninfu, env->posopeninfu, utagsize-1);
 	}
-	mpx_set_ui(negopenzerou, 0x9);
-		mpx_lshift(negopenzerou, negopenzerou, utagsize-1);
+	mpx_set_ui(env->negopenzerou, 0x9);
+		mpx_lshift(env->negopenzerou, env->negopenzerou, utagsize-1);
 
 	/* float type */
-	mpf_set_ui(maxreal, 1);
-		mpf_mul_2exp(maxreal, maxreal, fsizemax);
-		mpf_sub_ui(maxreal, maxreal, 1);
-		mpf_div_2exp(maxreal, maxreal, fsizemax-1);
-		mpf_mul_2exp(maxreal, maxreal, 1UL << (esizemax-1));
-	mpf_set_ui(smallsubnormal, 1);
-		mpf_div_2exp(smallsubnormal, smallsubnormal, (1UL << (esizemax-1))+fsizemax-2);
+	mpf_init2(env->maxreal, env->pbits);
+	mpf_init2(env->negmaxreal, env->pbits);
+	mpf_init2(env->smallsubnormal, env->pbits);
+	mpf_set_ui(env->maxreal, 1);
+		mpf_mul_2exp(env->maxreal, env->maxreal, env->fsizemax);
+		mpf_sub_ui(env->maxreal, env->maxreal, 1);
+		mpf_div_2exp(env->maxreal, env->maxreal, env->fsizemax-1);
+		mpf_mul_2exp(env->maxreal, env->maxreal, 1UL << (esizemax-1));
+	mpf_neg(env->negmaxreal, env->maxreal);
+	mpf_set_ui(env->smallsubnormal, 1);
+		mpf_div_2exp(env->smallsubnormal, env->smallsubnormal, (1UL << (esizemax-1))+env->fsizemax-2);
+
+	/* gbound type */
+	{
+		MPF_VAR2(tmpf, 64);
+		mpf_set_ui(tmpf, 0); init_const(&env->zerog, tmpf);
+		mpf_set_ui(tmpf, 1); init_const(&env->oneg, tmpf);
+		mpf_set_ui(tmpf, 2); init_const(&env->twog, tmpf);
+		mpf_set_ui(tmpf, 3); init_const(&env->threeg, tmpf);
+	}
+	init_const(&env->maxrealg, env->maxreal);
+
+	return env;
+}
+
+/* Return the environment for e and f, building it on first use.
+   Here, maximum esizesize is MAX_ESIZESIZE
+   and maximum fsizesize is MAX_FSIZESIZE. */
+
+const uenv_s *find_uenv(int e, int f)
+{
+	if (e < 0 || e > (int)MAX_ESIZESIZE || f < 0 || f > (int)MAX_FSIZESIZE) {
+		fprintf(stderr, " -- error: exponent size size or fraction size size out of range\n");
+		fprintf(stderr, " -- max exponent size size: %u\n", MAX_ESIZESIZE);
+		fprintf(stderr, " -- max fraction size size: %u\n", MAX_FSIZESIZE);
+		exit(EXIT_FAILURE);
+	}
+	if (cache[e][f] == NULL) cache[e][f] = make_uenv(e, f);
+	return cache[e][f];
+}
+
+/* Make env the calling thread's environment. No arithmetic is done,
+   the variables are pointed at the values in env. */
+
+void use_uenv(const uenv_s *env)
+{
+	const uenv_s *v = env;
+
+	current = env;
+
+	esizesize = v->esizesize;
+	fsizesize = v->fsizesize;
+	esizemax = v->esizemax;
+	fsizemax = v->fsizemax;
+	utagsize = v->utagsize;
+	maxubits = v->maxubits;
+	uenv64 = v->uenv64;
+	ulimbs = v->ulimbs;
+	plimbs = v->plimbs;
+	pbits = v->pbits;
+
+	one = v->one;
+	ubitmask = v->ubitmask;
+	fsizemask = v->fsizemask;
+	esizemask = v->esizemask;
+	efsizemask = v->efsizemask;
+	utagmask = v->utagmask;
+	ulpu = v->ulpu;
+	smallsubnormalu = v->smallsubnormalu;
+	smallnormalu = v->smallnormalu;
+	signbigu = v->signbigu;
+	posinfu = v->posinfu;
+	maxrealu = v->maxrealu;
+	minrealu = v->minrealu;
+	neginfu = v->neginfu;
+	negbigu = v->negbigu;
+	qNaNu = v->qNaNu;
+	sNaNu = v->sNaNu;
+	negopeninfu = v->negopeninfu;
+	posopeninfu = v->posopeninfu;
+	negopenzerou = v->negopenzerou;
+
+	maxreal = v->maxreal;
+	negmaxreal = v->negmaxreal;
+	smallsubnormal = v->smallsubnormal;
+
+	zerog = &v->zerog;
+	oneg = &v->oneg;
+	twog = &v->twog;
+	threeg = &v->threeg;
+	maxrealg = &v->maxrealg;
+}
+
+const uenv_s *cur_uenv(void)
+{
+	return current;
+}
+
+void set_uenv(int e, int f)
+{
+	if (current && current->esizesize == e && current->fsizesize == f) return;
+	use_uenv(find_uenv(e, f));
 }
@@ -28,6 +28,19 @@
 
 #include "mpx.h"
 
+/* Thread-local storage class */
+#if defined(UNUM_TLS)
+/* already defined, see unum.h */
+#elif defined(__GNUC__)
+#define UNUM_TLS __thread
+#elif defined(_MSC_VER)
+#define UNUM_TLS __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define UNUM_TLS _Thread_local
+#else
+#define UNUM_TLS
+#endif
+
 #define MAX_ESIZESIZE 4U
 #define MAX_FSIZESIZE 11U
 #define MAX_ESIZE (1U << MAX_ESIZESIZE)
@@ -56,40 +69,63 @@
 #error "utag size exceeds GMP limb size"
 #endif
 
-extern int esizesize;
-extern int fsizesize;
-extern int esizemax;
-extern int fsizemax;
-extern int utagsize;
-extern int maxubits;
-
-extern mp_size_t ulimbs;
-extern mp_size_t plimbs;
-extern mp_bitcnt_t pbits;
-
-extern mpx_t one;
-extern mpx_t ubitmask;
-extern mpx_t fsizemask;
-extern mpx_t esizemask;
-extern mpx_t efsizemask;
-extern mpx_t utagmask;
-extern mpx_t ulpu;
-extern mpx_t smallsubnormalu;
-extern mpx_t smallnormalu;
-extern mpx_t signbigu;
-extern mpx_t posinfu;
-extern mpx_t maxrealu;
-extern mpx_t minrealu;
-extern mpx_t neginfu;
-extern mpx_t negbigu;
-extern mpx_t qNaNu;
-extern mpx_t sNaNu;
-extern mpx_t negopeninfu;
-extern mpx_t posopeninfu;
-extern mpx_t negopenzerou;
-
-extern mpf_t maxreal;
-extern mpf_t smallsubnormal;
+/* The environment is thread-local: each thread has its own current
+   environment and must call set_uenv before using the library, and
+   clear_uenv before it exits. Threads with different environments do
+   not interfere. Values are only meaningful in the thread that made
+   them, or in another thread with the same environment. */
+
+extern UNUM_TLS int esizesize;
+extern UNUM_TLS int fsizesize;
+extern UNUM_TLS int esizemax;
+extern UNUM_TLS int fsizemax;
+extern UNUM_TLS int utagsize;
+extern UNUM_TLS int maxubits;
+
+extern UNUM_TLS int uenv64; /* native 64-bit engine in use, see ubnd64.h */
+
+extern UNUM_TLS mp_size_t ulimbs;
+extern UNUM_TLS mp_size_t plimbs;
+extern UNUM_TLS mp_bitcnt_t pbits;
+
+/* The masks and limits below point into the current environment's
+   descriptor, which is never changed after it is made, see use_uenv. */
+extern UNUM_TLS mpx_srcptr one;
+extern UNUM_TLS mpx_srcptr ubitmask;
+extern UNUM_TLS mpx_srcptr fsizemask;
+extern UNUM_TLS mpx_srcptr esizemask;
+extern UNUM_TLS mpx_srcptr efsizemask;
+extern UNUM_TLS mpx_srcptr utagmask;
+extern UNUM_TLS mpx_srcptr ulpu;
+extern UNUM_TLS mpx_srcptr smallsubnormalu;
+extern UNUM_TLS mpx_srcptr smallnormalu;
+extern UNUM_TLS mpx_srcptr signbigu;
+extern UNUM_TLS mpx_srcptr posinfu;
+extern UNUM_TLS mpx_srcptr maxrealu;
+extern UNUM_TLS mpx_srcptr minrealu;
+extern UNUM_TLS mpx_srcptr neginfu;
+extern UNUM_TLS mpx_srcptr negbigu;
+extern UNUM_TLS mpx_srcptr qNaNu;
+extern UNUM_TLS mpx_srcptr sNaNu;
+extern UNUM_TLS mpx_srcptr negopeninfu;
+extern UNUM_TLS mpx_srcptr posopeninfu;
+extern UNUM_TLS mpx_srcptr negopenzerou;
+
+extern UNUM_TLS mpf_srcptr maxreal;
+extern UNUM_TLS mpf_srcptr negmaxreal;
+extern UNUM_TLS mpf_srcptr smallsubnormal;
+
+/* Exact gbounds of environment constants, shared read-only by the
+   conversions, see glayer.h for struct gbnd_s. */
+struct gbnd_s;
+extern UNUM_TLS const struct gbnd_s *zerog;
+extern UNUM_TLS const struct gbnd_s *oneg;
+extern UNUM_TLS const struct gbnd_s *twog;
+extern UNUM_TLS const struct gbnd_s *threeg;
+extern UNUM_TLS const struct gbnd_s *maxrealg; /* maxrealu */
+
+/* An environment computed once per thread, see find_uenv. */
+typedef struct uenv_s uenv_s;
 
 #if defined(__cplusplus)
 extern "C" {
@@ -99,18 +135,18 @@ void init_uenv(void);
 void clear_uenv(void);
 void set_uenv(int e, int f);
 
+/* find_uenv builds an environment on first use and does not change the
+   current one. use_uenv makes env current by copying its sizes and mask
+   pointers into the thread-local variables above, some 35 stores and no
+   arithmetic. */
+const uenv_s *find_uenv(int e, int f);
+void use_uenv(const uenv_s *env);
+const uenv_s *cur_uenv(void);
+
 #if defined (__cplusplus)
 }
 #endif
 
-/* TODO: add uenv_s *arg to functions
-
-typedef struct uenv_s;
-
-void init_uenv(uenv_s *uenv, int e, int f);
-void set_uenv(uenv_s *uenv);
-void view_uenv(uenv_s *uenv);
-
-*/
+/* TODO: add uenv_s *arg to functions in place of thread-local state */
 
 #endif /* UENV_H_ */
@@ -41,13 +41,57 @@ void unum_copy(unum_s *dst, const unum_s *src)
 	mpx_set(dst, src);
 }
 
+#ifndef USE_MPN
+
+/* A ubound is one block: the two unum_s followed by their limbs, ulimbs
+   each, like UB_VAR. GMP must never reallocate limbs inside the block, so
+   after set_uenv changes to a larger environment call ubnd_resize. */
+#define UBND_BYTES(n) (2*sizeof(unum_s) + 2*(n)*sizeof(mp_limb_t))
+
+static void ubnd_place(ubnd_s *ub, void *blk, mp_size_t n)
+{
+	unum_s *u = (unum_s *)blk;
+	mp_limb_t *d = (mp_limb_t *)(u+2);
+
+	MPX_ALLOC(&u[0]) = MPX_ALLOC(&u[1]) = n;
+	MPX_SIZ(&u[0]) = MPX_SIZ(&u[1]) = 0;
+	MPX_PTR(&u[0]) = d;
+	MPX_PTR(&u[1]) = d+n;
+	ub->p = 0;
+	ub->l = &u[0];
+	ub->r = &u[1];
+}
+
+void ubnd_init(ubnd_s *ub)
+{
+	ubnd_place(ub, MP_ALLOC(UBND_BYTES(ulimbs)), ulimbs);
+}
+
+void ubnd_clear(ubnd_s *ub)
+{
+	MP_FREE(ub->l, UBND_BYTES(MPX_ALLOC(ub->l)));
+}
+
+/* An array of ubounds shares a single block, element after element.
+   Release it with ubnd_clear_n, not ubnd_clear. */
+
+void ubnd_init_n(ubnd_s *ub, size_t n)
+{
+	char *blk = (char *)MP_ALLOC(n * UBND_BYTES(ulimbs));
+	size_t i;
+
+	for (i = 0; i < n; i++) ubnd_place(&ub[i], blk + i*UBND_BYTES(ulimbs), ulimbs);
+}
+
+void ubnd_clear_n(ubnd_s *ub, size_t n)
+{
+	if (n) MP_FREE(ub[0].l, n * UBND_BYTES(MPX_ALLOC(ub[0].l)));
+}
+
+#else /* USE_MPN */
+
 void ubnd_init(ubnd_s *ub)
 {
-	/* TODO: change type of ub->l & r to unum_t? */
-#ifndef USE_MPN
-	ub->l = (unum_s *)MP_ALLOC(sizeof(unum_s));
-	ub->r = (unum_s *)MP_ALLOC(sizeof(unum_s));
-#endif
 	ub->p = 0;
 	mpx_init2(ub->l, UBITS);
 	mpx_init2(ub->r, UBITS);
@@ -55,13 +99,42 @@ void ubnd_init(ubnd_s *ub)
 
 void ubnd_clear(ubnd_s *ub)
 {
-	/* TODO: change type of ub->l & r to unum_t? */
 	mpx_clear(ub->l);
 	mpx_clear(ub->r);
+}
+
+void ubnd_init_n(ubnd_s *ub, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) ubnd_init(&ub[i]);
+}
+
+void ubnd_clear_n(ubnd_s *ub, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) ubnd_clear(&ub[i]);
+}
+
+#endif /* USE_MPN */
+
+/* Reallocate a ubound for the current environment, whose limbs are sized
+   by the environment at init. Without USE_MPN only a smaller ubound is
+   reallocated. The bits are kept, but unum bit fields only have meaning in
+   the environment that made them. */
+
+void ubnd_resize(ubnd_s *ub)
+{
+	ubnd_s t;
+
 #ifndef USE_MPN
-	MP_FREE(ub->l, sizeof(unum_s));
-	MP_FREE(ub->r, sizeof(unum_s));
+	if (MPX_ALLOC(ub->l) >= ulimbs) return;
 #endif
+	ubnd_init(&t);
+	ubnd_copy(&t, ub);
+	ubnd_clear(ub);
+	*ub = t;
 }
 
 void ubnd_copy(ubnd_s *dst, const ubnd_s *src)
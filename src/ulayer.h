@@ -71,8 +71,17 @@ void unum_init(unum_s *un);
 void unum_clear(unum_s *un);
 void unum_copy(unum_s *dst, const unum_s *src);
 
+/* A ubound holds the unums of the environment current at ubnd_init, or
+   at its last ubnd_resize, which it needs before use in a larger one.
+   Without USE_MPN the limbs of ub->l and ub->r live in the ubound's own
+   block, so raw mpz operations on them must not grow them: a GMP realloc
+   of those limbs corrupts the heap. Arrays from ubnd_init_n share one
+   block and cannot be resized. */
 void ubnd_init(ubnd_s *ub);
 void ubnd_clear(ubnd_s *ub);
+void ubnd_init_n(ubnd_s *ub, size_t n);
+void ubnd_clear_n(ubnd_s *ub, size_t n);
+void ubnd_resize(ubnd_s *ub);
 void ubnd_copy(ubnd_s *dst, const ubnd_s *src);
 
 #if defined (__cplusplus)
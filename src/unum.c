@@ -32,8 +32,8 @@
 
 /* use unum_ prefix on mlayer API (memory or machine layer) */
 
-size_t unum_sz;
-size_t ubnd_sz;
+UNUM_TLS size_t unum_sz;
+UNUM_TLS size_t ubnd_sz;
 
 /* Independent of the current environment */
 
@@ -50,49 +50,42 @@ int numbits(int e, int f, const unum *op)
 	return(2 + esize + fsize + e + f);
 }
 
-/* handles byte aligned unums */
-/* TODO: use offset parameter for bit-packed unums */
+/* A unum takes a fixed (maxubits + 7) / 8 bytes, least significant byte
+   first, and a ubound is the pair byte followed by two such unums.
+   See upack.c for bit-packed unums. */
+
+#define UNUM_BYTES ((maxubits + 7) / 8)
 
 unsigned int unum_load(unum_s *rop, const unum *op)
 {
-	unsigned int nbits = numbits(esizesize, fsizesize, op);
-	unsigned int nbytes = (nbits + 7) / 8;
-
-	mpx_import_b(rop, op, nbytes);
-	return(nbytes);
+	mpx_import_b(rop, op, UNUM_BYTES);
+	return(UNUM_BYTES);
 }
 
 unsigned int unum_store(unum *rop, const unum_s *op)
 {
-	unsigned int nbits = numbits(esizesize, fsizesize, MPX_PTR(op));
-	unsigned int nbytes = (nbits + 7) / 8;
-
-	mpx_export_b(rop, nbytes, op);
-	return(nbytes);
+	mpx_export_b(rop, UNUM_BYTES, op);
+	return(UNUM_BYTES);
 }
 
 unsigned int ubnd_load(ubnd_s *rop, const ubnd *op)
 {
-	unsigned int nbytes = 1, n;
 	unsigned char *ptr = (unsigned char *)op;
 
 	rop->p = *ptr++;
-	n = unum_load(rop->l, ptr);
-	nbytes += n;
-	if (rop->p) {ptr += n; n = unum_load(rop->r, ptr); nbytes += n;}
-	return(nbytes);
+	unum_load(rop->l, ptr);
+	if (rop->p) unum_load(rop->r, ptr + UNUM_BYTES);
+	return(1 + UNUM_BYTES * (rop->p ? 2 : 1));
 }
 
 unsigned int ubnd_store(ubnd *rop, const ubnd_s *op)
 {
-	unsigned int nbytes = 1, n;
 	unsigned char *ptr = (unsigned char *)rop;
 
 	*ptr++ = op->p;
-	n = unum_store(ptr, op->l);
-	nbytes += n;
-	if (op->p) {ptr += n; n = unum_store(ptr, op->r); nbytes += n;}
-	return(nbytes);
+	unum_store(ptr, op->l);
+	if (op->p) unum_store(ptr + UNUM_BYTES, op->r);
+	return(1 + UNUM_BYTES * (op->p ? 2 : 1));
 }
 
 void unum_init_env(void)
@@ -108,9 +101,8 @@ void unum_clear_env(void)
 void unum_set_env(int e, int f)
 {
 	set_uenv(e, f);
-	/* TODO: calculate size from (maxubits + 7) / 8 */
-	unum_sz = sizeof(mp_limb_t)*NLIMBS;
-	ubnd_sz = sizeof(mp_limb_t)*NLIMBS*2+1;
+	unum_sz = UNUM_BYTES;
+	ubnd_sz = 1 + 2*UNUM_BYTES;
 }
 
 void unum_get_env(int *e, int *f)
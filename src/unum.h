@@ -28,6 +28,19 @@
 
 #include <stdlib.h>
 
+/* Thread-local storage class, see uenv.h */
+#if defined(UNUM_TLS)
+/* already defined */
+#elif defined(__GNUC__)
+#define UNUM_TLS __thread
+#elif defined(_MSC_VER)
+#define UNUM_TLS __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define UNUM_TLS _Thread_local
+#else
+#define UNUM_TLS
+#endif
+
 #define UNUM_ALLOC(un) (un = malloc(unum_sz))
 #define UNUM_FREE(un) free(un)
 #define UNUM_VAR(un) char un[unum_sz]
@@ -52,8 +65,9 @@ inexact unums.
 /* If the first byte is one, then a pair of unums follow */
 typedef void ubnd;
 
-extern size_t unum_sz;
-extern size_t ubnd_sz;
+/* Sizes in the calling thread's environment, see unum_set_env */
+extern UNUM_TLS size_t unum_sz;
+extern UNUM_TLS size_t ubnd_sz;
 
 #if defined(__cplusplus)
 extern "C" {
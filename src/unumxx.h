@@ -47,6 +47,8 @@ see https://www.gnu.org/licenses/.  */
 #include "hlayer.h"
 #include "support.h"
 #include "ubnd.h"
+#include "gbnd.h"
+#include "ubnd64.h"
 
 // wrapper for gcc's __builtin_constant_p
 // __builtin_constant_p has been in gcc since forever,
@@ -97,11 +99,18 @@ typedef ubnd_s *ubnd_ptr;
 struct __unum_unary_plus
 {
   static void eval(ubnd_ptr f, ubnd_srcptr g) { ubnd_copy(f, g); }
+  static void geval(gbnd_s *f, const gbnd_s *g)
+  {
+    mpf_set(f->l.f, g->l.f); f->l.open = g->l.open; f->l.inf = g->l.inf;
+    mpf_set(f->r.f, g->r.f); f->r.open = g->r.open; f->r.inf = g->r.inf;
+    f->nan = g->nan;
+  }
 };
 
 struct __unum_unary_minus
 {
   static void eval(ubnd_ptr f, ubnd_srcptr g) { negateu(f, g); }
+  static void geval(gbnd_s *f, const gbnd_s *g) { negateg(f, g); }
 };
 
 struct __unum_unary_com
@@ -113,6 +122,9 @@ struct __unum_binary_plus
   static void eval(ubnd_ptr f, ubnd_srcptr g, ubnd_srcptr h)
   { plusu(f, g, h); }
 
+  static void geval(gbnd_s *f, const gbnd_s *g, const gbnd_s *h)
+  { plusg(f, g, h); }
+
   static void eval(ubnd_ptr f, ubnd_srcptr g, unsigned long int l)
   { UB_VAR(temp); ui2ub(temp, l); plusu(f, g, temp); }
   static void eval(ubnd_ptr f, unsigned long int l, ubnd_srcptr g)
@@ -134,6 +146,9 @@ struct __unum_binary_minus
   static void eval(ubnd_ptr f, ubnd_srcptr g, ubnd_srcptr h)
   { minusu(f, g, h); }
 
+  static void geval(gbnd_s *f, const gbnd_s *g, const gbnd_s *h)
+  { minusg(f, g, h); }
+
   static void eval(ubnd_ptr f, ubnd_srcptr g, unsigned long int l)
   { UB_VAR(temp); ui2ub(temp, l); minusu(f, g, temp); }
   static void eval(ubnd_ptr f, unsigned long int l, ubnd_srcptr g)
@@ -163,6 +178,9 @@ struct __unum_binary_multiplies
   static void eval(ubnd_ptr f, ubnd_srcptr g, ubnd_srcptr h)
   { if (g == h) squareu(f, g); else timesu(f, g, h); }
 
+  static void geval(gbnd_s *f, const gbnd_s *g, const gbnd_s *h)
+  { if (g == h) squareg(f, g); else timesg(f, g, h); }
+
   static void eval(ubnd_ptr f, ubnd_srcptr g, unsigned long int l)
   { UB_VAR(temp); ui2ub(temp, l); timesu(f, g, temp); }
   static void eval(ubnd_ptr f, unsigned long int l, ubnd_srcptr g)
@@ -184,6 +202,9 @@ struct __unum_binary_divides
   static void eval(ubnd_ptr f, ubnd_srcptr g, ubnd_srcptr h)
   { divideu(f, g, h); }
 
+  static void geval(gbnd_s *f, const gbnd_s *g, const gbnd_s *h)
+  { divideg(f, g, h); }
+
   static void eval(ubnd_ptr f, ubnd_srcptr g, unsigned long int l)
   { UB_VAR(temp); ui2ub(temp, l); divideu(f, g, temp); }
   static void eval(ubnd_ptr f, unsigned long int l, ubnd_srcptr g)
@@ -319,6 +340,7 @@ struct __unum_unary_decrement
 struct __unum_abs_function
 {
   static void eval(ubnd_ptr f, ubnd_srcptr g) { absu(f, g); }
+  static void geval(gbnd_s *f, const gbnd_s *g) { absg(f, g); }
 };
 
 struct __unum_trunc_function
@@ -336,11 +358,14 @@ struct __unum_ceil_function
 struct __unum_guess_function
 {
   static void eval(ubnd_ptr f, ubnd_srcptr g) { guessu(f->l, g); f->p = 0; }
+  static void geval(gbnd_s *f, const gbnd_s *g)
+  { UB_VAR(temp); g2u(temp, g); guessu(temp->l, temp); temp->p = 0; u2g(f, temp); }
 };
 
 struct __unum_sqrt_function
 {
   static void eval(ubnd_ptr f, ubnd_srcptr g) { sqrtu(f, g); }
+  static void geval(gbnd_s *f, const gbnd_s *g) { sqrtg(f, g); }
 };
 
 struct __unum_hypot_function
@@ -368,6 +393,9 @@ struct __unum_min_function
   static void eval(ubnd_ptr f, ubnd_srcptr g, ubnd_srcptr h)
   { minu(f, g, h); }
 
+  static void geval(gbnd_s *f, const gbnd_s *g, const gbnd_s *h)
+  { ming(f, g, h); }
+
   static void eval(ubnd_ptr f, ubnd_srcptr g, unsigned long int l)
   { UB_VAR(temp); ui2ub(temp, l); minu(f, g, temp); }
   static void eval(ubnd_ptr f, unsigned long int l, ubnd_srcptr g)
@@ -389,6 +417,9 @@ struct __unum_max_function
   static void eval(ubnd_ptr f, ubnd_srcptr g, ubnd_srcptr h)
   { maxu(f, g, h); }
 
+  static void geval(gbnd_s *f, const gbnd_s *g, const gbnd_s *h)
+  { maxg(f, g, h); }
+
   static void eval(ubnd_ptr f, ubnd_srcptr g, unsigned long int l)
   { UB_VAR(temp); ui2ub(temp, l); maxu(f, g, temp); }
   static void eval(ubnd_ptr f, unsigned long int l, ubnd_srcptr g)
@@ -586,12 +617,23 @@ class __unum_expr<ubnd_t, ubnd_t>
 {
 private:
   typedef ubnd_t value_type;
-  value_type mp;
+  mutable value_type mp;
+
+  // A default constructed or moved-from object owns no memory (mp->l is
+  // null) until its first use, so moves and swaps never allocate. An object
+  // made in a smaller environment grows on use (MPX_ALLOC is NLIMBS with
+  // USE_MPN, where the size is not known).
+  void alloc() const
+  {
+    if (!mp->l) ubnd_init(mp);
+    else if (MPX_ALLOC(mp->l) < (int)NLIMBS) ubnd_resize(mp);
+  }
+  void init_empty() { mp->p = 0; mp->l = mp->r = 0; }
 
   // Helper functions used for all arithmetic types
-  void assign_ui(unsigned long l) { ui2ub(mp, l); AGUESS(mp) }
-  void assign_si(signed long l) { si2ub(mp, l); AGUESS(mp) }
-  void assign_d(double d) { d2ub(mp, d); AGUESS(mp) }
+  void assign_ui(unsigned long l) { alloc(); ui2ub(mp, l); AGUESS(mp) }
+  void assign_si(signed long l) { alloc(); si2ub(mp, l); AGUESS(mp) }
+  void assign_d(double d) { alloc(); d2ub(mp, d); AGUESS(mp) }
 
   void init_ui(unsigned long l) { ubnd_init(mp); ui2ub(mp, l); }
   void init_si(signed long l) { ubnd_init(mp); si2ub(mp, l); }
@@ -601,13 +643,13 @@ public:
   mp_bitcnt_t get_prec() const { return NOT_USED; }
 
   // constructors and destructor
-  __unum_expr() { ubnd_init(mp); }
+  __unum_expr() { init_empty(); }
 
   __unum_expr(const __unum_expr &f)
-  { ubnd_init(mp); ubnd_copy(mp, f.mp); }
+  { ubnd_init(mp); ubnd_copy(mp, f.__get_mp()); }
 #if __UNUMXX_USE_CXX11
-  __unum_expr(__unum_expr &&f)
-  { *mp = *f.mp; ubnd_init(f.mp); }
+  __unum_expr(__unum_expr &&f) noexcept
+  { *mp = *f.mp; f.init_empty(); }
 #endif
 #if !defined(NO_EXPRESS)
   template <class T, class U>
@@ -627,50 +669,54 @@ public:
   explicit __unum_expr(ubnd_srcptr ub)
   { ubnd_init(mp); ubnd_copy(mp, ub); }
 
-  ~__unum_expr() { ubnd_clear(mp); }
+  ~__unum_expr() { if (mp->l) ubnd_clear(mp); }
 
   void swap(__unum_expr& f) __UNUMXX_NOEXCEPT { std::swap(*mp, *f.mp); }
 
   // assignment operators
   __unum_expr & operator=(const __unum_expr &f)
-  { ubnd_copy(mp, f.mp); AGUESS(mp) return *this; }
+  { alloc(); ubnd_copy(mp, f.__get_mp()); AGUESS(mp) return *this; }
 #if __UNUMXX_USE_CXX11
   __unum_expr & operator=(__unum_expr &&f) noexcept
-  { swap(f); AGUESS(mp) return *this; }
+  { swap(f); AGUESS(__get_mp()) return *this; }
 #endif
 #if !defined(NO_EXPRESS)
   template <class T, class U>
   __unum_expr<value_type, value_type> & operator=(const __unum_expr<T, U> &expr)
-  { __unum_set_expr(mp, expr); AGUESS(mp) return *this; }
+  { alloc(); __unum_set_expr(mp, expr); AGUESS(mp) return *this; }
 #endif
 
   __UNUMXX_DEFINE_ARITHMETIC_ASSIGNMENTS
 
   __unum_expr & operator=(const char *s)
-  { sscan_ub(s, mp); AGUESS(mp) return *this; }
+  { alloc(); sscan_ub(s, mp); AGUESS(mp) return *this; }
   __unum_expr & operator=(const std::string &s)
-  { sscan_ub(s.c_str(), mp); AGUESS(mp) return *this; }
+  { alloc(); sscan_ub(s.c_str(), mp); AGUESS(mp) return *this; }
 
   // conversion functions
   //__unum_expr guess() const { UB_VAR(ub); guessu(ub->l, mp); return __unum_expr(ub); }
-  ubnd_srcptr __get_mp() const { return mp; }
-  ubnd_ptr __get_mp() { return mp; }
-  ubnd_srcptr get_ubnd_t() const { return mp; }
-  ubnd_ptr get_ubnd_t() { return mp; }
-
-  signed long int get_si() const { return ub2si(mp); }
-  unsigned long int get_ui() const { return ub2ui(mp); }
-  double get_d() const { return ub2d(mp); }
-
-  int interval() const { return (mp->p) ? 2 : inexQ(mp->l) ? 1 : 0; }
-  int spans0() const { return mp->p && spanszerouQ(mp); }
-  int clipl(const __unum_expr &f) { return cliplu(mp, mp, f.mp); }
-  int cliph(const __unum_expr &f) { return cliphu(mp, mp, f.mp); }
+  ubnd_srcptr __get_mp() const { alloc(); return mp; }
+  ubnd_ptr __get_mp() { alloc(); return mp; }
+  ubnd_srcptr get_ubnd_t() const { return __get_mp(); }
+  ubnd_ptr get_ubnd_t() { return __get_mp(); }
+  void geval(gbnd_s *g) const { u2g(g, __get_mp()); }
+
+  signed long int get_si() const { return ub2si(__get_mp()); }
+  unsigned long int get_ui() const { return ub2ui(__get_mp()); }
+  double get_d() const { return ub2d(__get_mp()); }
+
+  int interval() const
+  { alloc(); return (mp->p) ? 2 : inexQ(mp->l) ? 1 : 0; }
+  int spans0() const { alloc(); return mp->p && spanszerouQ(mp); }
+  int clipl(const __unum_expr &f)
+  { alloc(); return cliplu(mp, mp, f.__get_mp()); }
+  int cliph(const __unum_expr &f)
+  { alloc(); return cliphu(mp, mp, f.__get_mp()); }
 
 #if __UNUMXX_USE_CXX11
   explicit operator bool() const
-  { UB_VAR(temp); ui2ub(temp, 0); return sameuQ(mp, temp) == 0; }
-  explicit operator double() const { return ub2d(mp); }
+  { UB_VAR(temp); ui2ub(temp, 0); return sameuQ(__get_mp(), temp) == 0; }
+  explicit operator double() const { return ub2d(__get_mp()); }
 #endif
 
   // compound assignments
@@ -749,6 +795,206 @@ inline std::istream & operator>>(std::istream &i, ubnd_c &val)
 
 #endif // NO_EXPRESS
 
+
+/**************** ubnd<ESS, FSS> -- ubound of a fixed environment ****************/
+/* The environment is a template argument, so its sizes are compile-time
+   constants and the unums are stored inline with no allocation. An
+   environment of at most UBND64_MAX_UBITS bits passes its sizes straight
+   to the native engine (see ubnd64.h), which leaves the thread's
+   environment alone. Anything else goes to the library, which reads the
+   thread's environment: the operation makes (ESS, FSS) current and
+   restores the caller's after, a table lookup and two use_uenv calls of
+   some 35 stores each. So ubnd objects of different environments, ubnd_c
+   objects and C calls can be mixed in one thread. A thread with no
+   environment is left in (ESS, FSS). */
+
+#if __UNUMXX_USE_CXX11
+
+template <int ESS, int FSS>
+struct uenv_c
+{
+  static_assert(ESS >= 0 && ESS <= (int)MAX_ESIZESIZE &&
+    FSS >= 0 && FSS <= (int)MAX_FSIZESIZE, "environment out of range");
+
+  static constexpr int esizesize = ESS;
+  static constexpr int fsizesize = FSS;
+  static constexpr int esizemax = 1 << ESS;
+  static constexpr int fsizemax = 1 << FSS;
+  static constexpr int utagsize = 1 + ESS + FSS;
+  static constexpr int maxubits = 1 + esizemax + fsizemax + utagsize;
+  static constexpr mp_size_t ulimbs = MPX_BITS2LIMBS(maxubits);
+  static constexpr mp_bitcnt_t pbits = FSIZE2PREC(fsizemax);
+  static constexpr mp_size_t plimbs = MPF_BITS2LIMBS(pbits);
+  static constexpr bool native = maxubits <= UBND64_MAX_UBITS;
+  static constexpr env64_s env64 =
+    {ESS, FSS, esizemax, fsizemax, utagsize, maxubits};
+
+  // (ESS, FSS) is the thread's environment for the life of a scope
+  class scope
+  {
+    const uenv_s *prev, *cur;
+  public:
+    scope() : prev(cur_uenv()), cur(find_uenv(ESS, FSS))
+    { if (prev != cur) use_uenv(cur); }
+    ~scope() { if (prev && prev != cur) use_uenv(prev); }
+  };
+};
+
+template <int ESS, int FSS>
+constexpr env64_s uenv_c<ESS, FSS>::env64;
+
+// Call the native engine for a ubnd whose environment fits it, without
+// touching the thread's environment. Not while counting operations, which
+// the library does, or with ROUND, whose rounding reads the thread's
+// environment. Operations return 0 when the engine leaves them to the
+// g-layer.
+#if defined(HAVE_UBND64) && !defined(ROUND)
+#define __UNUMXX_UBND64(call) (env::native && !USTATS_ON() && (call))
+#else
+#define __UNUMXX_UBND64(call) false
+#endif
+
+template <int ESS, int FSS>
+class ubnd
+{
+public:
+  typedef uenv_c<ESS, FSS> env;
+
+private:
+  template <int E, int F> friend class ubnd;
+  typedef typename env::scope scope;
+
+  mp_limb_t d[2][env::ulimbs];
+#if !defined(USE_MPN)
+  unum_s u[2];
+#endif
+  ubnd_s ub;
+
+  // zero, with no library call: the zero unum has no bits set
+  void place()
+  {
+#if defined(USE_MPN)
+    for (int i = 0; i < 2; i++)
+      for (mp_size_t k = 0; k < env::ulimbs; k++) d[i][k] = 0;
+    ub.l = d[0]; ub.r = d[1];
+#else
+    for (int i = 0; i < 2; i++) {
+      MPX_ALLOC(&u[i]) = env::ulimbs; MPX_SIZ(&u[i]) = 0; MPX_PTR(&u[i]) = d[i];
+    }
+    ub.l = &u[0]; ub.r = &u[1];
+#endif
+    ub.p = 0;
+  }
+  // copy of a ubnd of the same environment, also with no library call
+  void copy(const ubnd &x)
+  {
+    for (int i = 0; i < 2; i++)
+      for (mp_size_t k = 0; k < env::ulimbs; k++) d[i][k] = x.d[i][k];
+#if !defined(USE_MPN)
+    for (int i = 0; i < 2; i++) MPX_SIZ(&u[i]) = MPX_SIZ(&x.u[i]);
+#endif
+    ub.p = x.ub.p;
+  }
+
+public:
+  ubnd() { place(); }
+  ubnd(const ubnd &x) { place(); copy(x); }
+  ubnd(signed int i) { scope s; place(); si2ub(&ub, i); }
+  ubnd(signed long int l) { scope s; place(); si2ub(&ub, l); }
+  ubnd(unsigned int i) { scope s; place(); ui2ub(&ub, i); }
+  ubnd(unsigned long int l) { scope s; place(); ui2ub(&ub, l); }
+  ubnd(double f) { scope s; place(); d2ub(&ub, f); }
+  explicit ubnd(const char *s) { scope e; place(); sscan_ub(s, &ub); }
+
+  // conversion from another environment, through the g-layer
+  template <int E, int F>
+  explicit ubnd(const ubnd<E, F> &x)
+  {
+    GB_VAR2(g, (uenv_c<E, F>::pbits));
+    place();
+    { typename uenv_c<E, F>::scope s; u2g(&g, &x.ub); }
+    { scope s; g2u(&ub, &g); }
+  }
+
+  ubnd & operator=(const ubnd &x) { copy(x); return *this; }
+
+  ubnd_srcptr get_ubnd_t() const { return &ub; }
+  ubnd_ptr get_ubnd_t() { return &ub; }
+  double get_d() const { scope s; return ub2d(&ub); }
+
+  friend ubnd operator-(const ubnd &x)
+  { scope s; ubnd a; negateu(&a.ub, &x.ub); return a; }
+  friend ubnd operator+(const ubnd &x, const ubnd &y)
+  {
+    ubnd a;
+    if (!__UNUMXX_UBND64(plusu64(&env::env64, &a.ub, &x.ub, &y.ub)))
+      { scope s; plusu(&a.ub, &x.ub, &y.ub); }
+    return a;
+  }
+  friend ubnd operator-(const ubnd &x, const ubnd &y)
+  {
+    ubnd a;
+    if (!__UNUMXX_UBND64(minusu64(&env::env64, &a.ub, &x.ub, &y.ub)))
+      { scope s; minusu(&a.ub, &x.ub, &y.ub); }
+    return a;
+  }
+  friend ubnd operator*(const ubnd &x, const ubnd &y)
+  {
+    ubnd a;
+    if (&x == &y) {
+      if (!__UNUMXX_UBND64(squareu64(&env::env64, &a.ub, &x.ub)))
+        { scope s; squareu(&a.ub, &x.ub); }
+    } else if (!__UNUMXX_UBND64(timesu64(&env::env64, &a.ub, &x.ub, &y.ub)))
+      { scope s; timesu(&a.ub, &x.ub, &y.ub); }
+    return a;
+  }
+  friend ubnd operator/(const ubnd &x, const ubnd &y)
+  {
+    ubnd a;
+    if (!__UNUMXX_UBND64(divideu64(&env::env64, &a.ub, &x.ub, &y.ub)))
+      { scope s; divideu(&a.ub, &x.ub, &y.ub); }
+    return a;
+  }
+  friend ubnd abs(const ubnd &x) { scope s; ubnd a; absu(&a.ub, &x.ub); return a; }
+  friend ubnd sqrt(const ubnd &x)
+  {
+    ubnd a;
+    if (!__UNUMXX_UBND64(sqrtu64(&env::env64, &a.ub, &x.ub)))
+      { scope s; sqrtu(&a.ub, &x.ub); }
+    return a;
+  }
+  friend ubnd guess(const ubnd &x) { scope s; ubnd a; guessu(a.ub.l, &x.ub); return a; }
+
+  ubnd & operator+=(const ubnd &x) { return *this = *this + x; }
+  ubnd & operator-=(const ubnd &x) { return *this = *this - x; }
+  ubnd & operator*=(const ubnd &x) { return *this = *this * x; }
+  ubnd & operator/=(const ubnd &x) { return *this = *this / x; }
+
+  // the comparisons always have a native result
+  friend bool operator==(const ubnd &x, const ubnd &y)
+  {
+    if (__UNUMXX_UBND64(true)) return sameuQ64(&env::env64, &x.ub, &y.ub) != 0;
+    scope s; return sameuQ(&x.ub, &y.ub) != 0;
+  }
+  friend bool operator!=(const ubnd &x, const ubnd &y) { return !(x == y); }
+  friend bool operator<(const ubnd &x, const ubnd &y)
+  {
+    if (__UNUMXX_UBND64(true)) return ltuQ64(&env::env64, &x.ub, &y.ub) != 0;
+    scope s; return ltuQ(&x.ub, &y.ub) != 0;
+  }
+  friend bool operator>(const ubnd &x, const ubnd &y)
+  {
+    if (__UNUMXX_UBND64(true)) return gtuQ64(&env::env64, &x.ub, &y.ub) != 0;
+    scope s; return gtuQ(&x.ub, &y.ub) != 0;
+  }
+
+  friend std::ostream & operator<<(std::ostream &o, const ubnd &x)
+  { scope s; return o << &x.ub; }
+};
+
+#endif // __UNUMXX_USE_CXX11
+
+
 #if !defined(NO_EXPRESS)
 
 /**************** Functions for type conversion ****************/
@@ -761,12 +1007,42 @@ inline void __unum_set_expr(ubnd_ptr f, const ubnd_c &g)
 template <class T>
 inline void __unum_set_expr(ubnd_ptr f, const __unum_expr<ubnd_t, T> &expr)
 {
+#if defined(GLAYER_EXPRESS)
+  GB_VAR(g);
+  expr.geval(&g);
+  g2u(f, &g);
+#else
   expr.eval(f);
+#endif
 #if defined(AUTO_SPANSZERO)
   if (f->p && spanszerouQ(f)) abort();
 #endif
 }
 
+/* Per-expression g-layer evaluation, r = glayer((a+b)*(c-d)/e); */
+template <class T, class U>
+inline __unum_expr<T, T> glayer(const __unum_expr<T, U> &expr)
+{
+  GB_VAR(g);
+  __unum_expr<T, T> r;
+  expr.geval(&g);
+  g2u(r.__get_mp(), &g);
+  return r;
+}
+
+/* Per-expression deferred unify, r = deferred((a+b)*(c-d)/e);
+   the intermediates stay ubound pairs and only the result is unified. */
+template <class T, class U>
+inline __unum_expr<T, T> deferred(const __unum_expr<T, U> &expr)
+{
+  __unum_expr<T, T> r;
+  int prev = unify_defer(1);
+  __unum_set_expr(r.__get_mp(), expr);
+  unify_defer(prev);
+  unifyeq(r.__get_mp(), r.__get_mp());
+  return r;
+}
+
 /* Temporary objects */
 
 template <class T>
@@ -790,6 +1066,48 @@ class __unum_temp <ubnd_t>
   ubnd_srcptr __get_mp() const { return val.__get_mp(); }
 };
 
+/* g-layer evaluation of an operand */
+
+template <class T, class U>
+inline void __unum_geval(gbnd_s *g, const __unum_expr<T, U> &expr)
+{ expr.geval(g); }
+inline void __unum_geval(gbnd_s *g, signed long int l) { si2g(g, l); }
+inline void __unum_geval(gbnd_s *g, unsigned long int l) { ui2g(g, l); }
+inline void __unum_geval(gbnd_s *g, double d) { d2g(g, d); }
+
+/* A fused multiply-add inside an expression is rounded once by fmau, as
+   at the top level. */
+inline void __unum_fma_geval(gbnd_s *g, const ubnd_c &x, const ubnd_c &y,
+  const ubnd_c &z)
+{
+  UB_VAR(a);
+  fmau(a, x.__get_mp(), y.__get_mp(), z.__get_mp());
+  u2g(g, a);
+}
+
+#define __UNUMXX_DEFINE_UNARY_GEVAL \
+  void geval(gbnd_s *g) const \
+  { GB_VAR(h); __unum_geval(&h, expr.val); Op::geval(g, &h); }
+
+#define __UNUMXX_DEFINE_BINARY_GEVAL \
+  void geval(gbnd_s *g) const \
+  { \
+    GB_VAR(h1); GB_VAR(h2); \
+    __unum_geval(&h1, expr.val1); __unum_geval(&h2, expr.val2); \
+    Op::geval(g, &h1, &h2); \
+  }
+
+// a*a evaluates once and squares, as in __unum_binary_multiplies::eval
+#define __UNUMXX_DEFINE_SIMPLE_GEVAL \
+  void geval(gbnd_s *g) const \
+  { \
+    GB_VAR(h1); GB_VAR(h2); \
+    expr.val1.geval(&h1); \
+    if (&expr.val1 == &expr.val2) { Op::geval(g, &h1, &h1); return; } \
+    expr.val2.geval(&h2); \
+    Op::geval(g, &h1, &h2); \
+  }
+
 
 /**************** Specializations of __unum_expr ****************/
 /* The eval() method of __unum_expr<T, U> evaluates the corresponding
@@ -799,7 +1117,11 @@ class __unum_temp <ubnd_t>
    to hold intermediate values), while for simple expressions the eval()
    method of the appropriate function object (available as the Op argument
    of either __unum_unary_expr<T, Op> or __unum_binary_expr<T, U, Op>) is
-   called. */
+   called.
+   The geval() method evaluates the same expression into a gbnd_s.
+   With GLAYER_EXPRESS defined, assignment evaluates the whole expression
+   tree in the g-layer and converts to a ubound only once at the end,
+   so intermediate results are not rounded to unums. */
 
 
 /**************** Unary expressions ****************/
@@ -822,6 +1144,7 @@ public:
   void eval(typename __unum_resolve_expr<T>::ptr_type p) const
   { Op::eval(p, expr.val.__get_mp()); }
   const val_type & get_val() const { return expr.val; }
+  __UNUMXX_DEFINE_UNARY_GEVAL
   mp_bitcnt_t get_prec() const { return expr.val.get_prec(); }
 };
 
@@ -840,6 +1163,7 @@ public:
   void eval(typename __unum_resolve_expr<T>::ptr_type p) const
   { Op::eval(p, expr.val); }
   const val_type & get_val() const { return expr.val; }
+  __UNUMXX_DEFINE_UNARY_GEVAL
   mp_bitcnt_t get_prec() const { return NOT_USED; }
 };
 
@@ -858,6 +1182,7 @@ public:
   void eval(typename __unum_resolve_expr<T>::ptr_type p) const
   { expr.val.eval(p); Op::eval(p, p); }
   const val_type & get_val() const { return expr.val; }
+  __UNUMXX_DEFINE_UNARY_GEVAL
   mp_bitcnt_t get_prec() const { return expr.val.get_prec(); }
 };
 
@@ -890,6 +1215,7 @@ public:
   { Op::eval(p, expr.val1.__get_mp(), expr.val2.__get_mp()); }
   const val1_type & get_val1() const { return expr.val1; }
   const val2_type & get_val2() const { return expr.val2; }
+  __UNUMXX_DEFINE_SIMPLE_GEVAL
   mp_bitcnt_t get_prec() const
   {
     mp_bitcnt_t prec1 = expr.val1.get_prec(),
@@ -916,6 +1242,7 @@ public:
   { Op::eval(p, expr.val1.__get_mp(), expr.val2); }
   const val1_type & get_val1() const { return expr.val1; }
   const val2_type & get_val2() const { return expr.val2; }
+  __UNUMXX_DEFINE_BINARY_GEVAL
   mp_bitcnt_t get_prec() const { return expr.val1.get_prec(); }
 };
 
@@ -934,6 +1261,7 @@ public:
   { Op::eval(p, expr.val1, expr.val2.__get_mp()); }
   const val1_type & get_val1() const { return expr.val1; }
   const val2_type & get_val2() const { return expr.val2; }
+  __UNUMXX_DEFINE_BINARY_GEVAL
   mp_bitcnt_t get_prec() const { return expr.val2.get_prec(); }
 };
 
@@ -967,6 +1295,7 @@ public:
   }
   const val1_type & get_val1() const { return expr.val1; }
   const val2_type & get_val2() const { return expr.val2; }
+  __UNUMXX_DEFINE_BINARY_GEVAL
   mp_bitcnt_t get_prec() const
   {
     mp_bitcnt_t prec1 = expr.val1.get_prec(),
@@ -1002,6 +1331,7 @@ public:
   }
   const val1_type & get_val1() const { return expr.val1; }
   const val2_type & get_val2() const { return expr.val2; }
+  __UNUMXX_DEFINE_BINARY_GEVAL
   mp_bitcnt_t get_prec() const
   {
     mp_bitcnt_t prec1 = expr.val1.get_prec(),
@@ -1037,6 +1367,7 @@ public:
   }
   const val1_type & get_val1() const { return expr.val1; }
   const val2_type & get_val2() const { return expr.val2; }
+  __UNUMXX_DEFINE_BINARY_GEVAL
   mp_bitcnt_t get_prec() const
   {
     mp_bitcnt_t prec1 = expr.val1.get_prec(),
@@ -1072,6 +1403,7 @@ public:
   }
   const val1_type & get_val1() const { return expr.val1; }
   const val2_type & get_val2() const { return expr.val2; }
+  __UNUMXX_DEFINE_BINARY_GEVAL
   mp_bitcnt_t get_prec() const
   {
     mp_bitcnt_t prec1 = expr.val1.get_prec(),
@@ -1101,6 +1433,7 @@ public:
   }
   const val1_type & get_val1() const { return expr.val1; }
   const val2_type & get_val2() const { return expr.val2; }
+  __UNUMXX_DEFINE_BINARY_GEVAL
   mp_bitcnt_t get_prec() const { return expr.val1.get_prec(); }
 };
 
@@ -1122,6 +1455,7 @@ public:
   }
   const val1_type & get_val1() const { return expr.val1; }
   const val2_type & get_val2() const { return expr.val2; }
+  __UNUMXX_DEFINE_BINARY_GEVAL
   mp_bitcnt_t get_prec() const { return expr.val2.get_prec(); }
 };
 
@@ -1148,6 +1482,7 @@ public:
   }
   const val1_type & get_val1() const { return expr.val1; }
   const val2_type & get_val2() const { return expr.val2; }
+  __UNUMXX_DEFINE_BINARY_GEVAL
   mp_bitcnt_t get_prec() const
   {
     mp_bitcnt_t prec1 = expr.val1.get_prec(),
@@ -1176,6 +1511,7 @@ public:
   }
   const val1_type & get_val1() const { return expr.val1; }
   const val2_type & get_val2() const { return expr.val2; }
+  __UNUMXX_DEFINE_BINARY_GEVAL
   mp_bitcnt_t get_prec() const
   {
     mp_bitcnt_t prec1 = expr.val1.get_prec(),
@@ -1204,6 +1540,72 @@ public:
   }
   const val1_type & get_val1() const { return expr.val1; }
   const val2_type & get_val2() const { return expr.val2; }
+  __UNUMXX_DEFINE_BINARY_GEVAL
+  mp_bitcnt_t get_prec() const
+  {
+    mp_bitcnt_t prec1 = expr.val1.get_prec(),
+      prec2 = expr.val2.get_prec();
+    return (prec1 > prec2) ? prec1 : prec2;
+  }
+};
+
+
+// fused multiply-add, a*b+c and c+a*b evaluate with one fmau call
+
+template <class T>
+class __unum_expr
+<T, __unum_binary_expr<__unum_expr<T, __unum_binary_expr<__unum_expr<T, T>,
+  __unum_expr<T, T>, __unum_binary_multiplies> >, __unum_expr<T, T>, __unum_binary_plus> >
+{
+private:
+  typedef __unum_expr<T, __unum_binary_expr<__unum_expr<T, T>,
+    __unum_expr<T, T>, __unum_binary_multiplies> > val1_type;
+  typedef __unum_expr<T, T> val2_type;
+
+  __unum_binary_expr<val1_type, val2_type, __unum_binary_plus> expr;
+public:
+  __unum_expr(const val1_type &val1, const val2_type &val2)
+    : expr(val1, val2) { }
+  void eval(typename __unum_resolve_expr<T>::ptr_type p) const
+  {
+    fmau(p, expr.val1.get_val1().__get_mp(), expr.val1.get_val2().__get_mp(),
+      expr.val2.__get_mp());
+  }
+  void geval(gbnd_s *g) const
+  { __unum_fma_geval(g, expr.val1.get_val1(), expr.val1.get_val2(), expr.val2); }
+  const val1_type & get_val1() const { return expr.val1; }
+  const val2_type & get_val2() const { return expr.val2; }
+  mp_bitcnt_t get_prec() const
+  {
+    mp_bitcnt_t prec1 = expr.val1.get_prec(),
+      prec2 = expr.val2.get_prec();
+    return (prec1 > prec2) ? prec1 : prec2;
+  }
+};
+
+template <class T>
+class __unum_expr
+<T, __unum_binary_expr<__unum_expr<T, T>, __unum_expr<T, __unum_binary_expr<
+  __unum_expr<T, T>, __unum_expr<T, T>, __unum_binary_multiplies> >, __unum_binary_plus> >
+{
+private:
+  typedef __unum_expr<T, T> val1_type;
+  typedef __unum_expr<T, __unum_binary_expr<__unum_expr<T, T>,
+    __unum_expr<T, T>, __unum_binary_multiplies> > val2_type;
+
+  __unum_binary_expr<val1_type, val2_type, __unum_binary_plus> expr;
+public:
+  __unum_expr(const val1_type &val1, const val2_type &val2)
+    : expr(val1, val2) { }
+  void eval(typename __unum_resolve_expr<T>::ptr_type p) const
+  {
+    fmau(p, expr.val2.get_val1().__get_mp(), expr.val2.get_val2().__get_mp(),
+      expr.val1.__get_mp());
+  }
+  void geval(gbnd_s *g) const
+  { __unum_fma_geval(g, expr.val2.get_val1(), expr.val2.get_val2(), expr.val1); }
+  const val1_type & get_val1() const { return expr.val1; }
+  const val2_type & get_val2() const { return expr.val2; }
   mp_bitcnt_t get_prec() const
   {
     mp_bitcnt_t prec1 = expr.val1.get_prec(),
@@ -1465,7 +1867,7 @@ __UNUMN_DEFINE_BINARY_TYPE_FUNCTION(type, fun, eval_fun)
 template <class T, class U> \
 inline type##_c & type##_c::fun(const __unum_expr<T, U> &expr) \
 { \
-  __unum_set_expr(mp, __unum_expr<type##_t, __unum_binary_expr \
+  __unum_set_expr(__get_mp(), __unum_expr<type##_t, __unum_binary_expr \
 		 <type##_c, __unum_expr<T, U>, eval_fun> >(*this, expr)); \
   AGUESS(mp) return *this; \
 }
@@ -1475,7 +1877,7 @@ type2, bigtype) \
  \
 inline type##_c & type##_c::fun(type2 t) \
 { \
-  __unum_set_expr(mp, __unum_expr<type##_t, __unum_binary_expr \
+  __unum_set_expr(__get_mp(), __unum_expr<type##_t, __unum_binary_expr \
 		 <type##_c, bigtype, eval_fun> >(*this, t)); \
   AGUESS(mp) return *this; \
 }
@@ -1485,7 +1887,7 @@ inline type##_c & type##_c::fun(type2 t) \
 #define __UNUMP_DEFINE_COMPOUND_OPERATOR(type, fun, eval_fun) \
 inline type##_c & type##_c::fun(const type##_c &op) \
 { \
-  eval_fun::eval(mp, mp, op.__get_mp()); \
+  eval_fun::eval(__get_mp(), mp, op.__get_mp()); \
   AGUESS(mp) return *this; \
 }
 
@@ -1493,7 +1895,7 @@ inline type##_c & type##_c::fun(const type##_c &op) \
 type2, bigtype) \
 inline type##_c & type##_c::fun(type2 op) \
 { \
-  eval_fun::eval(mp, mp, static_cast<bigtype>(op)); \
+  eval_fun::eval(__get_mp(), mp, static_cast<bigtype>(op)); \
   AGUESS(mp) return *this; \
 }
 
@@ -1533,7 +1935,7 @@ __UNUM_DEFINE_COMPOUND_OPERATOR(ubnd, fun, eval_fun)
  \
 inline type##_c & type##_c::fun(mp_bitcnt_t l) \
 { \
-  __unum_set_expr(mp, __unum_expr<type##_t, __unum_binary_expr \
+  __unum_set_expr(__get_mp(), __unum_expr<type##_t, __unum_binary_expr \
     <type##_c, mp_bitcnt_t, eval_fun> >(*this, l)); \
   return *this; \
 }
@@ -1545,14 +1947,14 @@ __UNUM_DEFINE_COMPOUND_OPERATOR_UI(ubnd, fun, eval_fun)
  \
 inline type##_c & type##_c::fun() \
 { \
-  eval_fun::eval(mp); \
+  eval_fun::eval(__get_mp()); \
   return *this; \
 } \
  \
 inline type##_c type##_c::fun(int) \
 { \
   type##_c temp(*this); \
-  eval_fun::eval(mp); \
+  eval_fun::eval(__get_mp()); \
   return temp; \
 }
 
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2016, Lawrence Livermore National Security, LLC. 
+ * Produced at the Lawrence Livermore National Laboratory. Written by
+ * G. Scott Lloyd, lloyd23@llnl.gov. LLNL-CODE-704762. All rights reserved.
+ * 
+ * This file is part of Unum. For details, see
+ * http://github.com/LLNL/unum
+ * 
+ * Please also read COPYING  Our Notice and GNU Lesser General Public 
+ * License. 
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License (as published by the 
+ * Free Software Foundation) version 2.1 dated February 1999. 
+ * 
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and 
+ * conditions of the GNU General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU Lesser General Public License 
+ * along with this program; if not, write to the Free Software Foundation, 
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#include <stdio.h> /* fprintf */
+#include <stdlib.h> /* realloc, free, exit */
+#include <string.h> /* memset */
+
+#include "upack.h"
+#include "uenv.h"
+
+/* Bytes kept zero past the used bits, so reads of a few bytes beyond
+   the last unum stay in the buffer. */
+#define SLACK 8
+
+#define MAX_UBYTES ((MAX_UBITS + 7) / 8)
+
+static void *grow(void *p, size_t size)
+{
+	void *q = realloc(p, size);
+
+	if (q == NULL) {
+		fprintf(stderr, " -- error: upack out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	return q;
+}
+
+/* Read n <= 25 bits at bit offset off. */
+static unsigned long getbits(const unsigned char *b, size_t off, int n)
+{
+	const unsigned char *p = b + off/8;
+	unsigned long t = p[0] | (unsigned long)p[1] << 8 |
+		(unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+
+	return (t >> off%8) & ((1UL << n) - 1);
+}
+
+/* Number of bits in the unum at bit offset off, as numbits in unum.c. */
+static unsigned int ubits(const upack_s *v, size_t off)
+{
+	unsigned long tmp = getbits(v->buf, off, v->e + v->f);
+	unsigned int fsize = (tmp & ((1UL << v->f)-1)) + 1;
+	unsigned int esize = (tmp >> v->f) + 1;
+
+	return 2 + esize + fsize + v->e + v->f;
+}
+
+/* Decode the unum at bit offset off, return the offset after it. */
+static size_t load(unum_s *rop, const upack_s *v, size_t off)
+{
+	unsigned int nbits = ubits(v, off);
+	unsigned int nbytes = (nbits + 7) / 8, s = off % 8, j;
+	const unsigned char *p = v->buf + off/8;
+	unsigned char tmp[MAX_UBYTES];
+
+	for (j = 0; j < nbytes; j++)
+		tmp[j] = (unsigned char)(p[j] >> s | p[j+1] << (8-s));
+	if (nbits % 8) tmp[nbytes-1] &= (1U << nbits%8) - 1;
+	mpx_import_b(rop, tmp, nbytes);
+	return off + nbits;
+}
+
+/* Skip the ubound at bit offset off without decoding it. */
+static size_t skip(const upack_s *v, size_t off)
+{
+	int p = getbits(v->buf, off, 1);
+
+	off = off + 1;
+	off += ubits(v, off);
+	if (p) off += ubits(v, off);
+	return off;
+}
+
+static void reserve(upack_s *v, size_t nbits)
+{
+	size_t need = (v->nbits + nbits + 7) / 8 + SLACK;
+
+	if (need > v->nbytes) {
+		size_t size = 2 * v->nbytes;
+		if (size < need) size = need;
+		v->buf = (unsigned char *)grow(v->buf, size);
+		memset(v->buf + v->nbytes, 0, size - v->nbytes);
+		v->nbytes = size;
+	}
+}
+
+static void store(upack_s *v, const unum_s *op)
+{
+	unsigned char tmp[MAX_UBYTES+4];
+	unsigned char *p;
+	unsigned int ebytes = (maxubits + 7) / 8, nbits, nbytes, s, j;
+	unsigned long tag;
+
+	mpx_export_b(tmp, ebytes, op);
+	memset(tmp + ebytes, 0, 4);
+	tag = getbits(tmp, 0, v->e + v->f);
+	nbits = 2 + v->e + v->f + (tag & ((1UL << v->f)-1)) + 1 + (tag >> v->f) + 1;
+	nbytes = (nbits + 7) / 8;
+	reserve(v, nbits);
+	p = v->buf + v->nbits/8;
+	s = v->nbits % 8;
+	for (j = 0; j < nbytes; j++) {
+		p[j] |= (unsigned char)(tmp[j] << s);
+		p[j+1] |= (unsigned char)(tmp[j] >> (8-s));
+	}
+	v->nbits += nbits;
+}
+
+void upack_init(upack_s *v)
+{
+	v->buf = NULL;
+	v->nbits = v->nbytes = v->n = 0;
+	v->idx = NULL;
+	v->nidx = 0;
+	v->e = esizesize;
+	v->f = fsizesize;
+	reserve(v, 0);
+}
+
+void upack_clear(upack_s *v)
+{
+	free(v->buf);
+	free(v->idx);
+}
+
+void upack_push(upack_s *v, const ubnd_s *ub)
+{
+	if (v->n % UPACK_STRIDE == 0) {
+		size_t k = v->n / UPACK_STRIDE;
+		if (k == v->nidx) {
+			v->nidx = v->nidx ? 2 * v->nidx : 16;
+			v->idx = (size_t *)grow(v->idx, v->nidx * sizeof(size_t));
+		}
+		v->idx[k] = v->nbits;
+	}
+	reserve(v, 1);
+	if (ub->p) v->buf[v->nbits/8] |= 1U << v->nbits%8;
+	v->nbits++;
+	store(v, ub->l);
+	if (ub->p) store(v, ub->r);
+	v->n++;
+}
+
+void upack_begin(upack_iter_s *it, const upack_s *v, size_t i)
+{
+	size_t k = i / UPACK_STRIDE;
+
+	it->v = v;
+	if (i >= v->n) {
+		it->off = v->nbits;
+		it->i = v->n;
+		return;
+	}
+	it->off = v->idx[k];
+	for (it->i = k * UPACK_STRIDE; it->i < i; it->i++)
+		it->off = skip(v, it->off);
+}
+
+int upack_next(ubnd_s *a, upack_iter_s *it)
+{
+	const upack_s *v = it->v;
+
+	if (it->i >= v->n) return 0;
+	a->p = getbits(v->buf, it->off, 1);
+	it->off = load(a->l, v, it->off + 1);
+	if (a->p) it->off = load(a->r, v, it->off);
+	it->i++;
+	return 1;
+}
+
+void upack_get(ubnd_s *a, const upack_s *v, size_t i)
+{
+	upack_iter_s it;
+
+	upack_begin(&it, v, i);
+	if (!upack_next(a, &it)) {
+		fprintf(stderr, " -- error: upack index %lu out of range\n", (unsigned long)i);
+		exit(EXIT_FAILURE);
+	}
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2016, Lawrence Livermore National Security, LLC. 
+ * Produced at the Lawrence Livermore National Laboratory. Written by
+ * G. Scott Lloyd, lloyd23@llnl.gov. LLNL-CODE-704762. All rights reserved.
+ * 
+ * This file is part of Unum. For details, see
+ * http://github.com/LLNL/unum
+ * 
+ * Please also read COPYING  Our Notice and GNU Lesser General Public 
+ * License. 
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License (as published by the 
+ * Free Software Foundation) version 2.1 dated February 1999. 
+ * 
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and 
+ * conditions of the GNU General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU Lesser General Public License 
+ * along with this program; if not, write to the Free Software Foundation, 
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#ifndef UPACK_H_
+#define UPACK_H_
+
+#include "ulayer.h" /* ubnd_s */
+
+/* Every UPACK_STRIDE-th ubound has its bit offset in the index. */
+#define UPACK_STRIDE 32
+
+/* A packed vector stores ubounds back to back at bit granularity, least
+   significant bit first: a pair bit, then the left unum and, if the pair
+   bit is set, the right unum, each taking only its own numbits. The
+   vector is tied to the environment it was initialized in. */
+typedef struct {
+	unsigned char *buf; /* packed bits */
+	size_t nbits;       /* bits used */
+	size_t nbytes;      /* bytes allocated */
+	size_t n;           /* number of ubounds */
+	size_t *idx;        /* bit offset of ubound i*UPACK_STRIDE */
+	size_t nidx;        /* index entries allocated */
+	int e, f;           /* esizesize and fsizesize */
+} upack_s;
+
+/* Sequential reader, see upack_begin and upack_next. */
+typedef struct {
+	const upack_s *v;
+	size_t off; /* bit offset of the next ubound */
+	size_t i;   /* index of the next ubound */
+} upack_iter_s;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+void upack_init(upack_s *v);
+void upack_clear(upack_s *v);
+
+/* Append a ubound. */
+void upack_push(upack_s *v, const ubnd_s *ub);
+
+/* Decode ubound i, skipping at most UPACK_STRIDE-1 ubounds from the
+   nearest index entry. */
+void upack_get(ubnd_s *a, const upack_s *v, size_t i);
+
+/* Position an iterator at ubound i. upack_next decodes the next ubound
+   and returns zero when there are no more. */
+void upack_begin(upack_iter_s *it, const upack_s *v, size_t i);
+int upack_next(ubnd_s *a, upack_iter_s *it);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* UPACK_H_ */
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2016, Lawrence Livermore National Security, LLC. 
+ * Produced at the Lawrence Livermore National Laboratory. Written by
+ * G. Scott Lloyd, lloyd23@llnl.gov. LLNL-CODE-704762. All rights reserved.
+ * 
+ * This file is part of Unum. For details, see
+ * http://github.com/LLNL/unum
+ * 
+ * Please also read COPYING  Our Notice and GNU Lesser General Public 
+ * License. 
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License (as published by the 
+ * Free Software Foundation) version 2.1 dated February 1999. 
+ * 
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and 
+ * conditions of the GNU General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU Lesser General Public License 
+ * along with this program; if not, write to the Free Software Foundation, 
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#include <stdlib.h> /* malloc, free */
+#include <pthread.h>
+#include <unistd.h> /* sysconf */
+
+#include "upool.h"
+#include "uenv.h"
+#include "ubnd.h"
+#include "conv.h" /* guessu_n, unify_defer, unify_smart */
+
+typedef enum {PLUS, MINUS, TIMES, DIVIDE, SQRT, GUESS} op_t;
+
+typedef struct {
+	op_t op;
+	ubnd_s *a;
+	const ubnd_s *u;
+	const ubnd_s *v;
+	size_t n;
+	size_t next; /* next element to hand out in dynamic mode */
+	int e, f; /* environment of the caller */
+	int defer; /* unify policy of the caller, see conv.h */
+	double ratio;
+} job_s;
+
+static struct {
+	pthread_mutex_t lock; /* protects the fields below and job.next */
+	pthread_cond_t start;
+	pthread_cond_t done;
+	pthread_mutex_t use; /* one call in the pool at a time */
+	pthread_t *tid;
+	int nthreads; /* including the caller */
+	int busy; /* workers still running the current job */
+	int quit;
+	unsigned long gen; /* job generation */
+	job_s job;
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+	PTHREAD_COND_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 0,
+	{PLUS, NULL, NULL, NULL, 0, 0, 0, 0, 0, 0.0}};
+
+static int deterministic;
+
+static void runop(const job_s *j, size_t lo, size_t hi)
+{
+	size_t n = hi - lo;
+
+	switch (j->op) {
+	case PLUS: plusu_n(j->a+lo, j->u+lo, j->v+lo, n); break;
+	case MINUS: minusu_n(j->a+lo, j->u+lo, j->v+lo, n); break;
+	case TIMES: timesu_n(j->a+lo, j->u+lo, j->v+lo, n); break;
+	case DIVIDE: divideu_n(j->a+lo, j->u+lo, j->v+lo, n); break;
+	case SQRT: sqrtu_n(j->a+lo, j->u+lo, n); break;
+	case GUESS: guessu_n(j->a+lo, j->u+lo, n); break;
+	}
+}
+
+/* Run the share of thread k, 0 being the caller. */
+
+static void runjob(job_s *j, int k)
+{
+	size_t lo, hi;
+
+	if (deterministic) {
+		lo = j->n * k / pool.nthreads;
+		hi = j->n * (k+1) / pool.nthreads;
+		if (lo < hi) runop(j, lo, hi);
+		return;
+	}
+	for (;;) {
+		pthread_mutex_lock(&pool.lock);
+		lo = j->next;
+		hi = (j->n - lo > UPOOL_CHUNK) ? lo + UPOOL_CHUNK : j->n;
+		j->next = hi;
+		pthread_mutex_unlock(&pool.lock);
+		if (lo >= hi) break;
+		runop(j, lo, hi);
+	}
+}
+
+static void *worker(void *arg)
+{
+	int k = (int)(long)arg;
+	int e = -1, f = -1;
+	unsigned long gen = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&pool.lock);
+		while (pool.gen == gen && !pool.quit)
+			pthread_cond_wait(&pool.start, &pool.lock);
+		if (pool.quit) {
+			pthread_mutex_unlock(&pool.lock);
+			break;
+		}
+		gen = pool.gen;
+		pthread_mutex_unlock(&pool.lock);
+
+		if (pool.job.e != e || pool.job.f != f) {
+			e = pool.job.e;
+			f = pool.job.f;
+			set_uenv(e, f);
+		}
+		unify_defer(pool.job.defer);
+		unify_smart(pool.job.ratio);
+		runjob(&pool.job, k);
+
+		pthread_mutex_lock(&pool.lock);
+		if (--pool.busy == 0) pthread_cond_signal(&pool.done);
+		pthread_mutex_unlock(&pool.lock);
+	}
+	if (e >= 0) clear_uenv();
+	return(NULL);
+}
+
+void upool_init(int nthreads)
+{
+	int k;
+
+	upool_clear();
+	if (nthreads <= 0) nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads < 2) return;
+	pool.tid = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+	pool.quit = 0;
+	pool.gen = 0;
+	/* With fewer threads than asked for, the pool is smaller; with none,
+	   the _p operations run serially. */
+	for (k = 1; k < nthreads; k++)
+		if (pthread_create(&pool.tid[k], NULL, worker, (void *)(long)k)) break;
+	pool.nthreads = k;
+}
+
+void upool_clear(void)
+{
+	int k;
+
+	if (!pool.nthreads) return;
+	pthread_mutex_lock(&pool.lock);
+	pool.quit = 1;
+	pthread_cond_broadcast(&pool.start);
+	pthread_mutex_unlock(&pool.lock);
+	for (k = 1; k < pool.nthreads; k++) pthread_join(pool.tid[k], NULL);
+	free(pool.tid);
+	pool.nthreads = 0;
+}
+
+int upool_threads(void)
+{
+	return pool.nthreads ? pool.nthreads : 1;
+}
+
+void upool_deterministic(int on)
+{
+	deterministic = on;
+}
+
+static void dispatch(op_t op, ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n)
+{
+	job_s *j = &pool.job;
+
+	if (pool.nthreads < 2 || n < 2*UPOOL_CHUNK) {
+		job_s s = {op, a, u, v, n, 0, 0, 0, 0, 0.0};
+		runop(&s, 0, n);
+		return;
+	}
+	pthread_mutex_lock(&pool.use);
+	j->op = op;
+	j->a = a;
+	j->u = u;
+	j->v = v;
+	j->n = n;
+	j->next = 0;
+	j->e = esizesize;
+	j->f = fsizesize;
+	unify_defer(j->defer = unify_defer(0));
+	unify_smart(j->ratio = unify_smart(0));
+	pthread_mutex_lock(&pool.lock);
+	pool.busy = pool.nthreads - 1;
+	pool.gen++;
+	pthread_cond_broadcast(&pool.start);
+	pthread_mutex_unlock(&pool.lock);
+
+	runjob(j, 0);
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.busy) pthread_cond_wait(&pool.done, &pool.lock);
+	pthread_mutex_unlock(&pool.lock);
+	pthread_mutex_unlock(&pool.use);
+}
+
+void plusu_p(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n)
+{
+	dispatch(PLUS, a, u, v, n);
+}
+
+void minusu_p(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n)
+{
+	dispatch(MINUS, a, u, v, n);
+}
+
+void timesu_p(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n)
+{
+	dispatch(TIMES, a, u, v, n);
+}
+
+void divideu_p(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n)
+{
+	dispatch(DIVIDE, a, u, v, n);
+}
+
+void sqrtu_p(ubnd_s *a, const ubnd_s *u, size_t n)
+{
+	dispatch(SQRT, a, u, NULL, n);
+}
+
+void guessu_p(ubnd_s *a, const ubnd_s *u, size_t n)
+{
+	dispatch(GUESS, a, u, NULL, n);
+}
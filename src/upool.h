@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2016, Lawrence Livermore National Security, LLC. 
+ * Produced at the Lawrence Livermore National Laboratory. Written by
+ * G. Scott Lloyd, lloyd23@llnl.gov. LLNL-CODE-704762. All rights reserved.
+ * 
+ * This file is part of Unum. For details, see
+ * http://github.com/LLNL/unum
+ * 
+ * Please also read COPYING  Our Notice and GNU Lesser General Public 
+ * License. 
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License (as published by the 
+ * Free Software Foundation) version 2.1 dated February 1999. 
+ * 
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and 
+ * conditions of the GNU General Public License for more details. 
+ * 
+ * You should have received a copy of the GNU Lesser General Public License 
+ * along with this program; if not, write to the Free Software Foundation, 
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA 
+ */
+
+#ifndef UPOOL_H_
+#define UPOOL_H_
+
+#include "ulayer.h" /* ubnd_s */
+
+/* Chunk of elements taken at a time by a thread in dynamic mode. */
+#define UPOOL_CHUNK 32
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* Thread pool for the parallel batch operations. upool_init starts
+   nthreads-1 worker threads, the calling thread being the other one;
+   nthreads <= 0 uses the number of online processors. Each worker keeps
+   its own environment and unify policy, switched to the caller's per
+   call, and its own g-layer scratch. Without a pool, or if no worker
+   thread could be created, the _p operations run the _n operations in
+   the calling thread. */
+void upool_init(int nthreads);
+void upool_clear(void);
+int upool_threads(void);
+
+/* In deterministic mode each thread handles a fixed contiguous range of
+   the arrays, otherwise chunks are handed out as threads become free.
+   Results are the same in either mode. */
+void upool_deterministic(int on);
+
+/* Parallel element-wise operations over arrays of n ubounds, as the _n
+   operations. Only one call uses the pool at a time. */
+void plusu_p(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n);
+void minusu_p(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n);
+void timesu_p(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n);
+void divideu_p(ubnd_s *a, const ubnd_s *u, const ubnd_s *v, size_t n);
+void sqrtu_p(ubnd_s *a, const ubnd_s *u, size_t n);
+void guessu_p(ubnd_s *a, const ubnd_s *u, size_t n);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* UPOOL_H_ */
@@ -158,6 +158,11 @@ int main(int argc, char *argv[])
 		unum_get_env(&ess, &fss);
 		printf("\n# test unum conversions, env:%d,%d #\n", ess, fss);
 
+		/* 33-bit unums */
+		fail |= !(ok = unum_sz == 5 && ubnd_sz == 11);
+		printf("%s sizes unum %lu ubnd %lu\n", ok ? "OK  " : "FAIL",
+			(unsigned long)unum_sz, (unsigned long)ubnd_sz);
+
 #define UNUM_SI(val,chk) \
 		si1 = val; unum_set_si(un, si1); si2 = unum_get_si(un); \
 		fail |= !(ok = si2 == chk); \
@@ -12,7 +12,7 @@ TARG = tbasic
 
 #DEFS += $(if $(findstring Windows_NT,$(OS)),-DTIMEOFDAY,-DGETTIME)
 
-MODULES = conv gbnd glayer gmp_aux hlayer support ubnd uenv ulayer unum
+MODULES = conv gbnd glayer gmp_aux hlayer support ubnd ubnd64 uenv ulayer unum upack upool
 
 OBJECTS = $(addsuffix .o,$(TARG) $(MODULES))
 HEADERS = $(addsuffix .h,$(MODULES)) mpx.h gmp_macro.h
@@ -31,7 +31,7 @@ CFLAGS = $(OPT) -Wall
 ifdef GMP
   LDFLAGS = -L$(GMP)/.libs
 endif
-LDLIBS = -lgmp
+LDLIBS = -lgmp -lpthread
 
 .PHONY: all
 all: $(TARG)
@@ -59,12 +59,15 @@ $(OBJECTS): $(MAKEFILE_LIST) # rebuild if MAKEFILE changes
 $(TARG).o: $(HEADERS)
 #module.o: module.h
 conv.o: conv.h support.h gbnd.h uenv.h glayer.h ulayer.h mpx.h gmp_aux.h
-gbnd.o: gbnd.h glayer.h
+gbnd.o: gbnd.h glayer.h uenv.h mpx.h gmp_aux.h
 glayer.o: glayer.h uenv.h mpx.h gmp_aux.h
 gmp_aux.o: gmp_aux.h
 hlayer.o: hlayer.h conv.h support.h uenv.h glayer.h ulayer.h mpx.h gmp_aux.h
 support.o: support.h uenv.h glayer.h ulayer.h mpx.h gmp_aux.h
-ubnd.o: ubnd.h conv.h support.h gbnd.h uenv.h glayer.h ulayer.h mpx.h gmp_aux.h
-uenv.o: uenv.h mpx.h
+ubnd.o: ubnd.h ubnd64.h conv.h support.h gbnd.h uenv.h glayer.h ulayer.h mpx.h gmp_aux.h
+ubnd64.o: ubnd64.h conv.h uenv.h glayer.h ulayer.h mpx.h gmp_aux.h
+uenv.o: uenv.h ubnd64.h mpx.h gmp_aux.h
 ulayer.o: ulayer.h uenv.h mpx.h gmp_aux.h
 unum.o: unum.h ubnd.h uenv.h ulayer.h mpx.h gmp_aux.h
+upack.o: upack.h uenv.h glayer.h ulayer.h mpx.h gmp_aux.h
+upool.o: upool.h ubnd.h conv.h uenv.h glayer.h ulayer.h mpx.h gmp_aux.h
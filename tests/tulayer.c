@@ -12,6 +12,7 @@ $Log: $
 #include <ctype.h> /* isdigit */
 #include <errno.h> /* errno */
 #include <math.h> /* NAN, INFINITY */
+#include <pthread.h> /* pthread_create, pthread_join */
 //#define NDEBUG 1
 //#include <assert.h> /* assert */
 
@@ -19,7 +20,11 @@ $Log: $
 #include "conv.h"
 #include "support.h"
 #include "ubnd.h"
+#include "gbnd.h"
 #include "hlayer.h"
+#include "upool.h"
+#include "upack.h"
+#include "ubnd64.h" /* HAVE_UBND64 */
 
 #define PROG "tulayer"
 #ifndef VERSION
@@ -37,6 +42,65 @@ int flags; /* argument flags */
 int iarg = DEFAULT_INT; /* int argument */
 char *sarg = DEFAULT_STR; /* string argument */
 
+typedef struct {
+	int e, f;
+	char str[2048];
+} uenv_job;
+
+/* GMP memory functions that count calls, for the allocation test. */
+static void *(*gmp_alloc)(size_t);
+static void *(*gmp_realloc)(void *, size_t, size_t);
+static void (*gmp_free)(void *, size_t);
+static unsigned long gmp_calls;
+
+static void *count_alloc(size_t n)
+{
+	gmp_calls++;
+	return gmp_alloc(n);
+}
+
+static void *count_realloc(void *p, size_t o, size_t n)
+{
+	gmp_calls++;
+	return gmp_realloc(p, o, n);
+}
+
+static void count_free(void *p, size_t n)
+{
+	gmp_calls++;
+	gmp_free(p, n);
+}
+
+/* Run a fixed sequence of operations in its own environment. */
+static void *uenv_work(void *arg)
+{
+	uenv_job *job = (uenv_job *)arg;
+
+	set_uenv(job->e, job->f);
+	{
+		UB_VAR(x);
+		UB_VAR(y);
+		UB_VAR(a);
+		UB_VAR(b);
+		int i;
+
+		sscan_ub("0.1", x);
+		sscan_ub("1.1", a);
+		sscan_ub("(0.3,0.31)", b);
+		for (i = 0; i < 200; i++) {
+			timesu(y, x, a);
+			plusu(x, y, b);
+			if (gtuQ(x, a)) {
+				sqrtu(y, x);
+				minusu(x, y, b);
+			}
+		}
+		sprint_ub(job->str, x);
+	}
+	clear_uenv();
+	return(NULL);
+}
+
 
 int main(int argc, char *argv[])
 {
@@ -428,6 +492,868 @@ int main(int argc, char *argv[])
 	}
 #endif
 
+/* UB_VAR, GB_VAR and MPF_VAR are sized by the current environment, so
+   the blocks below that switch environments first set the largest one
+   they use. */
+#if 1
+	set_uenv(4, 5);
+	{
+		UB_VAR(ub1);
+		UB_VAR(ub2);
+		UB_VAR(ubn);
+		UB_VAR(ubg);
+		/* 2,3 3,4 2,5 and the widest native envs, 4,5 at 59 bits and 0,5 */
+		static const int envs[][2] = {{2,3}, {3,4}, {2,5}, {4,5}, {0,5}};
+		mpx_srcptr *ends[] = {&smallsubnormalu, &smallnormalu, &maxrealu, &minrealu,
+			&posinfu, &neginfu, &posopeninfu, &negopeninfu, &negopenzerou, &qNaNu};
+		const int nends = sizeof(ends)/sizeof(ends[0]);
+		int e, i, j, ok, fail = 0;
+		int save;
+
+		printf("\n# test native engine against g-layer, env:2,3 3,4 2,5 4,5 0,5 #\n");
+
+#define UB_AOP64(oper) \
+		uenv64 = save; oper##u(ubn, ub1, ub2); \
+		uenv64 = 0;    oper##u(ubg, ub1, ub2); \
+		fail |= !(ok = ubn->p == ubg->p && \
+			mpx_cmp(ubn->l, ubg->l) == 0 && mpx_cmp(ubn->r, ubg->r) == 0); \
+		if (!ok) {printf("FAIL "); print_ub(ub1); printf(" %s ", #oper); print_ub(ub2); putchar('\n');}
+#define UB_ROP64(oper) \
+		uenv64 = save; ir = oper##uQ(ub1, ub2); \
+		uenv64 = 0; \
+		fail |= !(ok = ir == oper##uQ(ub1, ub2)); \
+		if (!ok) {printf("FAIL "); print_ub(ub1); printf(" %s ", #oper); print_ub(ub2); putchar('\n');}
+#define UB_UOP64(oper) \
+		uenv64 = save; oper##u(ubn, ub1); \
+		uenv64 = 0;    oper##u(ubg, ub1); \
+		fail |= !(ok = ubn->p == ubg->p && \
+			mpx_cmp(ubn->l, ubg->l) == 0 && mpx_cmp(ubn->r, ubg->r) == 0); \
+		if (!ok) {printf("FAIL %s ", #oper); print_ub(ub1); putchar('\n');}
+#define UB_CMP64(ue, ve) \
+		uenv64 = save; ir = cmpuQ(ub1, ue, ub2, ve); \
+		uenv64 = 0; \
+		fail |= !(ok = ir == cmpuQ(ub1, ue, ub2, ve)); \
+		if (!ok) {printf("FAIL "); print_ub(ub1); printf(" cmp %s %s ", #ue, #ve); print_ub(ub2); putchar('\n');}
+#define UB_SWEEP64 \
+		UB_AOP64(plus); \
+		UB_AOP64(minus); \
+		UB_AOP64(times); \
+		UB_AOP64(divide); \
+		UB_UOP64(square); \
+		UB_UOP64(sqrt); \
+		UB_ROP64(lt); \
+		UB_ROP64(gt); \
+		UB_ROP64(same); \
+		UB_ROP64(neq); \
+		UB_ROP64(nneq); \
+		UB_CMP64(LE, LE); \
+		UB_CMP64(LE, RE); \
+		UB_CMP64(RE, LE); \
+		UB_CMP64(RE, RE); \
+		uenv64 = save; ir = spanszerouQ(ub1); \
+		uenv64 = 0; \
+		fail |= !(ok = ir == spanszerouQ(ub1)); \
+		if (!ok) {printf("FAIL spanszero "); print_ub(ub1); putchar('\n');}
+		for (e = 0; e < (int)(sizeof(envs)/sizeof(envs[0])); e++) {
+			set_uenv(envs[e][0], envs[e][1]);
+			save = uenv64;
+#if defined(HAVE_UBND64)
+			fail |= !save;
+#endif
+			for (i = -20; i <= 20; i++) {
+				for (j = -20; j <= 20; j++) {
+					int ir;
+					d2ub(ub1, i / 8.0);
+					d2ub(ub2, (j & 1) ? j / 10.0 : j / 4.0);
+					UB_SWEEP64;
+					/* bounds, some of which span zero */
+					d2ub(ubg, (i + 5) / 8.0);
+					ub1->p = 1; mpx_set(ub1->r, ubg->l);
+					d2ub(ubg, (j + 3) / 4.0);
+					ub2->p = 1; mpx_set(ub2->r, ubg->l);
+					UB_SWEEP64;
+				}
+			}
+			/* extremes of the environment and small values against them */
+			for (i = 0; i < nends + 3; i++) {
+				for (j = 0; j < nends + 3; j++) {
+					int ir;
+					if (i < nends) {ub1->p = 0; mpx_set(ub1->l, *ends[i]); mpx_set(ub1->r, *ends[i]);}
+					else d2ub(ub1, (i - nends - 1) * 1.5);
+					if (j < nends) {ub2->p = 0; mpx_set(ub2->l, *ends[j]); mpx_set(ub2->r, *ends[j]);}
+					else d2ub(ub2, (j - nends - 1) * 0.75);
+					UB_SWEEP64;
+				}
+			}
+			uenv64 = save;
+			printf("%s env:%d,%d native engine sweep\n", fail ? "FAIL" : "OK  ", esizesize, fsizesize);
+		}
+		/* one size step past 64 bits falls back to the g-layer */
+		set_uenv(2, 6);
+		fail |= !(ok = !uenv64);
+		printf("%s env:2,6 maxubits %d, no native engine\n", ok ? "OK  " : "FAIL", maxubits);
+
+		tfail |= fail;
+	}
+#endif
+
+#if 1
+	set_uenv(4, 7);
+	{
+		UB_VAR(ub1);
+		UB_VAR(ub2);
+		gbnd_t g1, g2;
+		utag_s ut;
+		int e, i, j, ok, fail = 0;
+		int save;
+
+		gbnd_init(g1);
+		gbnd_init(g2);
+#define UB_ROPB(oper) \
+		fail |= !(ok = oper##uQ(ub1, ub2) == oper##gQ(g1, g2)); \
+		if (!ok) {printf("FAIL "); print_ub(ub1); printf(" %s ", #oper); print_ub(ub2); putchar('\n');}
+#define UB_CMPB(ue, ve) \
+		fail |= !(ok = cmpuQ(ub1, ue, ub2, ve) == cmpgQ(g1, ue, g2, ve)); \
+		if (!ok) {printf("FAIL "); print_ub(ub1); printf(" cmp "); print_ub(ub2); putchar('\n');}
+#define UB_ALLB \
+		u2g(g1, ub1); u2g(g2, ub2); \
+		UB_ROPB(lt); UB_ROPB(gt); UB_ROPB(neq); UB_ROPB(nneq); UB_ROPB(same); \
+		UB_CMPB(LE, LE); UB_CMPB(LE, RE); UB_CMPB(RE, LE); UB_CMPB(RE, RE);
+		/* every pair of unums */
+		set_uenv(1, 1);
+		save = uenv64; uenv64 = 0;
+		printf("\n# test bit-level comparison against g-layer, env:%d,%d #\n", esizesize, fsizesize);
+		for (i = 0; i < (1 << maxubits); i++) {
+			mpx_set_ui(ub1->l, i); ub1->p = 0;
+			utag(&ut, ub1->l);
+			if (i >> (1 + ut.esize + ut.fsize + utagsize)) continue;
+			for (j = 0; j < (1 << maxubits); j++) {
+				mpx_set_ui(ub2->l, j); ub2->p = 0;
+				utag(&ut, ub2->l);
+				if (j >> (1 + ut.esize + ut.fsize + utagsize)) continue;
+				UB_ALLB
+			}
+		}
+		uenv64 = save;
+		/* multi-limb fractions */
+		for (e = 0; e < 2; e++) {
+			if (e) set_uenv(4, 7); else set_uenv(3, 6);
+			printf("# env:%d,%d #\n", esizesize, fsizesize);
+			for (i = -20; i <= 20; i++) {
+				for (j = -20; j <= 20; j++) {
+					d2ub(ub1, (i & 1) ? i / 3.0 : i / 8.0);
+					d2ub(ub2, (j & 1) ? j / 10.0 : j / 4.0);
+					UB_ALLB
+					ub1->p = 1; d2un(ub1->r, i / 7.0 + 2.5);
+					UB_ALLB
+					if (j & 1) {mpx_set(ub2->l, posinfu); ub2->p = 0;}
+					else {mpx_set(ub2->l, negopeninfu); ub2->p = 1; mpx_set(ub2->r, maxrealu); mpx_ior(ub2->r, ub2->r, ubitmask);}
+					UB_ALLB
+				}
+			}
+		}
+		printf("%s bit-level comparison\n", fail ? "FAIL" : "OK  ");
+
+		gbnd_clear(g1);
+		gbnd_clear(g2);
+		tfail |= fail;
+	}
+#endif
+
+#if 1
+	set_uenv(4, 7);
+	{
+		UB_VAR(ub1);
+		UB_VAR(ub2);
+		UB_VAR(ubn);
+		UB_VAR(ubg);
+		MPX_VAR(un);
+		MPX_VAR(ug);
+		gbnd_t g1, g2, gr;
+		mpf_t f;
+		mpz_t z;
+		mp_limb_t m[3];
+		int e, i, j, k, ok, fail = 0;
+		/* f2u() of these, in env 2,3 3,5 4,7, from the mpf code mpn2u() replaced */
+		static const double gv[16] = {0.0, 1.0, -1.0, 0.1, -3.75, 1.0/3, 65535.5, -2.5e10,
+			3 * 0x1p-20, 1e-5, 1e300, -1e-300, 0x1p-6, 0x1p-14, 0x1.8p-16, 1e38};
+		static const mp_limb_t golden[3][16][3] = {
+			{ /* 2,3 */
+				{0x0, 0x0, 0x0}, {0x40, 0x0, 0x0}, {0x140, 0x0, 0x0}, {0xe67f, 0x0, 0x0},
+				{0x7c2, 0x0, 0x0}, {0x5577, 0x0, 0x0}, {0x3ffbf, 0x0, 0x0}, {0x7ffbf, 0x0, 0x0},
+				{0x3f, 0x0, 0x0}, {0x3f, 0x0, 0x0}, {0x3ffbf, 0x0, 0x0}, {0x4003f, 0x0, 0x0},
+				{0x98, 0x0, 0x0}, {0x5f, 0x0, 0x0}, {0x3f, 0x0, 0x0}, {0x3ffbf, 0x0, 0x0},
+			},
+			{ /* 3,5 */
+				{0x0, 0x0, 0x0}, {0x200, 0x0, 0x0}, {0xa00, 0x0, 0x0}, {0x7333333337f, 0x0, 0x0},
+				{0x3e02, 0x0, 0x0}, {0x2aaaaaaab5f, 0x0, 0x0}, {0x3dfffe8f, 0x0, 0x0}, {0x385d21dbad8, 0x0, 0x0},
+				{0x32a0, 0x0, 0x0}, {0x1c9f16b11dbf, 0x0, 0x0}, {0x1fffffffffdff, 0x0, 0x0}, {0x20000000001ff, 0x0, 0x0},
+				{0x460, 0x0, 0x0}, {0x480, 0x0, 0x0}, {0x3ea0, 0x0, 0x0}, {0x1fa59da6543ff, 0x0, 0x0},
+			},
+			{ /* 4,7 */
+				{0x0, 0x0, 0x0}, {0x1000, 0x0, 0x0}, {0x5000, 0x0, 0x0}, {0xccccccccccccd1b2, 0x1, 0x0},
+				{0x1f002, 0x0, 0x0}, {0x5555555555555133, 0x1, 0x0}, {0x1effff20f, 0x0, 0x0}, {0x1c2e90edd318, 0x0, 0x0},
+				{0x19280, 0x0, 0x0}, {0x4f8b588e368f12b3, 0xe, 0x0}, {0xdf90f22001d67531, 0x1f8, 0x0}, {0x56e1fc2f8f359533, 0x81a, 0x0},
+				{0x2180, 0x0, 0x0}, {0x2200, 0x0, 0x0}, {0x1f280, 0x0, 0x0}, {0x2ced32a16a1b13b3, 0xfd, 0x0},
+			},
+		};
+
+		gbnd_init(g1);
+		gbnd_init(g2);
+		gbnd_init(gr);
+		mpf_init2(f, 512);
+		printf("\n# test limb encoder and exact adder, multiplier, env:2,3 3,5 4,7 #\n");
+		for (e = 0; e < 3; e++) {
+			long bias, s;
+			if (e == 0) set_uenv(2, 3);
+			else if (e == 1) set_uenv(3, 5);
+			else set_uenv(4, 7);
+			bias = (1L << (esizemax-1)) - 1;
+			/* mpn2u() bounds the value */
+			for (k = 0; k < 400; k++) {
+				for (i = 0; i < 3; i++) m[i] = ((mp_limb_t)rand() << 31 ^ rand()) << 2 ^ rand();
+				if (k % 4 == 0) {m[0] = k; m[1] = m[2] = 0;}
+				if (k % 4 == 1) {m[0] = ~(mp_limb_t)0; m[1] = (k & 8) ? ~(mp_limb_t)0 : 0; m[2] = 0;}
+				m[0] |= k % 3 == 0;
+				for (s = -bias - fsizemax - 200; s <= bias + 4; s += (s < -bias - fsizemax - 64 || s > -bias + 2) ? 7 : 1) {
+					mpn2u(un, k & 1, m, 3, s);
+					mpf_set_z(f, mpz_roinit_n(z, m, 3));
+					if (k & 1) mpf_neg(f, f);
+					if (s >= 0) mpf_mul_2exp(f, f, s); else mpf_div_2exp(f, f, -s);
+					unum2g(g1, un);
+					if (exQ(un)) ok = !g1->l.inf && mpf_cmp(g1->l.f, f) == 0;
+					else ok = (g1->l.inf ? mpf_sgn(g1->l.f) < 0 : mpf_cmp(g1->l.f, f) < 0) &&
+						(g1->r.inf ? mpf_sgn(g1->r.f) > 0 : mpf_cmp(f, g1->r.f) < 0);
+					fail |= !ok;
+					if (!ok) {printf("FAIL mpn2u k:%d s:%ld ", k, s); print_un(un); putchar('\n');}
+				}
+			}
+#if GMP_NUMB_BITS == 64
+			/* f2u() gives the same, shortest encodings as before */
+			for (i = 0; i < 16; i++) {
+				mpf_set_d(f, gv[i]);
+				f2u(ug, f);
+				ok = ULIMB(ug, 0) == golden[e][i][0] && ULIMB(ug, 1) == golden[e][i][1] &&
+					ULIMB(ug, 2) == golden[e][i][2];
+				fail |= !ok;
+				if (!ok) {printf("FAIL f2u %g ", gv[i]); print_un(ug); putchar('\n');}
+			}
+#endif
+			/* exact plusu(), minusu() and timesu() against the g-layer */
+#define SAMEBITS(a,b) ((a)->p == (b)->p && mpx_cmp((a)->l, (b)->l) == 0 && \
+	(!(a)->p || mpx_cmp((a)->r, (b)->r) == 0))
+			for (i = -40; i <= 40; i++) {
+				for (j = -40; j <= 40; j++) {
+					d2ub(ub1, i * 3.0 / 64);
+					d2ub(ub2, (j & 1) ? j * 1e6 : j / 1024.0 / 1024.0);
+					u2g(g1, ub1);
+					u2g(g2, ub2);
+					plusu(ubn, ub1, ub2);
+					plusg(gr, g1, g2);
+					g2u(ubg, gr);
+					fail |= !(ok = SAMEBITS(ubn, ubg));
+					if (!ok) {printf("FAIL "); print_ub(ub1); printf(" + "); print_ub(ub2); putchar('\n');}
+					minusu(ubn, ub1, ub2);
+					minusg(gr, g1, g2);
+					g2u(ubg, gr);
+					fail |= !(ok = SAMEBITS(ubn, ubg));
+					if (!ok) {printf("FAIL "); print_ub(ub1); printf(" - "); print_ub(ub2); putchar('\n');}
+					timesu(ubn, ub1, ub2);
+					timesg(gr, g1, g2);
+					g2u(ubg, gr);
+					fail |= !(ok = SAMEBITS(ubn, ubg));
+					if (!ok) {printf("FAIL "); print_ub(ub1); printf(" * "); print_ub(ub2); putchar('\n');}
+				}
+			}
+			/* operand-sized plusg() and timesg() keep the whole span and a carry */
+			mpf_set_ui(f, ~(mp_limb_t)0 << 11);
+			f2g(g1, f);
+			mpf_set_ui(f, 1);
+			mpf_div_2exp(f, f, 90);
+			mpf_add_ui(f, f, 2048);
+			f2g(g2, f);
+			plusg(gr, g1, g2);
+			mpf_add(f, g1->l.f, g2->l.f);
+			fail |= !(ok = mpf_cmp(gr->l.f, f) == 0 && mpf_cmp(gr->r.f, f) == 0);
+			timesg(gr, g1, g2);
+			mpf_mul(f, g1->l.f, g2->l.f);
+			fail |= !(ok &= mpf_cmp(gr->l.f, f) == 0 && mpf_cmp(gr->r.f, f) == 0);
+			if (!ok) {printf("FAIL plusg/timesg "); print_gb(g1); printf(", "); print_gb(g2); putchar('\n');}
+		}
+		printf("%s limb encoder and exact adder, multiplier\n", fail ? "FAIL" : "OK  ");
+
+		mpf_clear(f);
+		gbnd_clear(g1);
+		gbnd_clear(g2);
+		gbnd_clear(gr);
+		tfail |= fail;
+	}
+#endif
+
+#if 1
+	set_uenv(3, 5);
+	{
+#define NB 200
+		ubnd_s u[NB], v[NB], r[NB], s[NB];
+		int e, i, k, m, ok, fail = 0;
+
+		for (i = 0; i < NB; i++) {
+			ubnd_init(&u[i]);
+			ubnd_init(&v[i]);
+		}
+		ubnd_init_n(r, NB);
+		ubnd_init_n(s, NB);
+		printf("\n# test batch operations, env:2,3 3,5, deferred and smart unify #\n");
+		upool_init(4);
+		for (e = 0; e < 6; e++) {
+			if (e % 2 == 0) set_uenv(2, 3); else set_uenv(3, 5);
+			/* the workers must follow the caller's unify policy */
+			unify_defer(e / 2 == 1);
+			unify_smart((e / 2 == 2) ? 0.25 : 0);
+			for (i = 0; i < NB; i++) {
+				d2ub(&u[i], (rand() - RAND_MAX/2) / 1024.0);
+				d2ub(&v[i], (i % 3) ? rand() / (double)(i+1) : i / 16.0);
+				if (i % 4 == 0) plusu(&u[i], &u[i], &v[i]); /* inexact */
+			}
+			for (k = 0; k < 7*3; k++) {
+				m = k / 7; /* serial, parallel dynamic, parallel deterministic */
+				upool_deterministic(m == 2);
+				for (i = 0; i < NB; i++) {
+					ubnd_copy(&r[i], &u[i]);
+					if (k % 7 == 0) plusu(&s[i], &u[i], &v[i]);
+					else if (k % 7 == 1) minusu(&s[i], &u[i], &v[i]);
+					else if (k % 7 == 2) timesu(&s[i], &u[i], &v[i]);
+					else if (k % 7 == 3) divideu(&s[i], &u[i], &v[i]);
+					else if (k % 7 == 4) sqrtu(&s[i], &u[i]);
+					else if (k % 7 == 5) {guessu(s[i].l, &u[i]); s[i].p = 0;}
+					else plusu(&s[i], &v[i], &v[i]);
+				}
+				if (k == 0) plusu_n(r, r, v, NB); /* in place */
+				else if (k == 1) minusu_n(r, r, v, NB);
+				else if (k == 2) timesu_n(r, r, v, NB);
+				else if (k == 3) divideu_n(r, r, v, NB);
+				else if (k == 4) sqrtu_n(r, r, NB);
+				else if (k == 5) guessu_n(r, r, NB);
+				else if (k == 6) plusu_n(r, v, v, NB);
+				else if (k % 7 == 0) plusu_p(r, r, v, NB);
+				else if (k % 7 == 1) minusu_p(r, r, v, NB);
+				else if (k % 7 == 2) timesu_p(r, r, v, NB);
+				else if (k % 7 == 3) divideu_p(r, r, v, NB);
+				else if (k % 7 == 4) sqrtu_p(r, r, NB);
+				else if (k % 7 == 5) guessu_p(r, r, NB);
+				else plusu_p(r, v, v, NB);
+				for (i = 0; i < NB; i++) {
+					ok = r[i].p == s[i].p && mpx_cmp(r[i].l, s[i].l) == 0 &&
+						(!s[i].p || mpx_cmp(r[i].r, s[i].r) == 0);
+					fail |= !ok;
+					if (!ok) {printf("FAIL op:%d ", k); print_ub(&u[i]); printf(", "); print_ub(&v[i]); putchar('\n');}
+				}
+			}
+		}
+		unify_defer(0);
+		unify_smart(0);
+		printf("%s batch and %d thread batch against scalar operations\n", fail ? "FAIL" : "OK  ", upool_threads());
+		upool_clear();
+
+		for (i = 0; i < NB; i++) {
+			ubnd_clear(&u[i]);
+			ubnd_clear(&v[i]);
+		}
+		ubnd_clear_n(r, NB);
+		ubnd_clear_n(s, NB);
+#undef NB
+		tfail |= fail;
+	}
+#endif
+
+#if 1
+	{
+		ubnd_t a, b, d;
+		int ok;
+
+		printf("\n# test ubound in a larger environment, env:2,2 4,7 #\n");
+		set_uenv(2, 2);
+		ubnd_init(a);
+		ubnd_init(b);
+		ok = MPX_ALLOC(a->l) == (int)NLIMBS; /* sized by env:2,2 */
+		clear_uenv();
+		ubnd_init(d); /* no environment */
+		set_uenv(4, 7);
+		ubnd_resize(a);
+		ubnd_resize(b);
+		ubnd_resize(d);
+		{
+			UB_VAR(c);
+			d2ub(a, 1.0);
+			d2ub(b, 3.0);
+			divideu(a, a, b);
+			d2ub(d, 1.0);
+			divideu(d, d, b);
+			d2ub(c, 1.0);
+			divideu(c, c, b);
+			ok = ok && MPX_ALLOC(a->l) >= (int)NLIMBS && sameuQ(a, c) && sameuQ(d, c);
+#ifndef USE_MPN
+			set_uenv(2, 2);
+			ubnd_resize(a); /* already large enough */
+			set_uenv(4, 7);
+			ok = ok && sameuQ(a, c);
+#endif
+		}
+		printf("%s ", ok ? "OK  " : "FAIL"); print_ub(a); putchar('\n');
+		ubnd_clear(a);
+		ubnd_clear(b);
+		ubnd_clear(d);
+		tfail |= !ok;
+	}
+#endif
+
+#if 1
+	{
+		const uenv_s *env[2];
+		char s0[2][256], s1[256];
+		int e, i, ok = 1;
+
+		printf("\n# test environment switching, env:2,3 4,7 #\n");
+		env[0] = find_uenv(2, 3);
+		env[1] = find_uenv(4, 7);
+		for (e = 0; e < 2; e++) {
+			UB_VAR(a);
+			use_uenv(env[e]);
+			d2ub(a, 1.0/3.0);
+			sprint_ub(s0[e], a);
+		}
+		for (i = 0; i < 100 && ok; i++) {
+			e = i & 1;
+			set_uenv(e ? 4 : 2, e ? 7 : 3);
+			{
+				UB_VAR(a);
+				d2ub(a, 1.0/3.0);
+				sprint_ub(s1, a);
+			}
+			ok = cur_uenv() == env[e] && maxubits == (e ? 157 : 19) &&
+				strcmp(s0[e], s1) == 0;
+		}
+		printf("%s %s %s\n", ok ? "OK  " : "FAIL", s0[0], s0[1]);
+
+		tfail |= !ok;
+	}
+#endif
+
+#if 1
+	set_uenv(4, 7);
+	{
+		GB_VAR(g);
+		MPF_VAR(f);
+		int e, ok, fail = 0;
+
+		printf("\n# test environment constants, env:0,0 2,3 4,7 #\n");
+		for (e = 0; e < 3; e++) {
+			if (e == 0) set_uenv(0, 0);
+			else if (e == 1) set_uenv(2, 3);
+			else set_uenv(4, 7);
+			ok = samegQ(zerog, ui2g(&g, 0)) && samegQ(oneg, ui2g(&g, 1)) &&
+				samegQ(twog, ui2g(&g, 2)) && samegQ(threeg, ui2g(&g, 3));
+			unum2g(&g, maxrealu);
+			ok = ok && samegQ(maxrealg, &g);
+			unum2g(&g, minrealu);
+			ok = ok && mpf_cmp(g.l.f, negmaxreal) == 0;
+			u2f(f, smallsubnormalu);
+			ok = ok && mpf_cmp(f, smallsubnormal) == 0;
+			gmp_printf("%s env:%d,%d smallsubnormal %Fe\n", ok ? "OK  " : "FAIL",
+				esizesize, fsizesize, smallsubnormal);
+			fail |= !ok;
+		}
+		/* building a new environment leaves the current one alone */
+		{
+			mp_size_t nl = ulimbs;
+			find_uenv(4, 9);
+			ok = ulimbs == nl && esizesize == 4 && fsizesize == 7;
+		}
+		printf("%s find_uenv(4,9) keeps env:4,7\n", ok ? "OK  " : "FAIL");
+		fail |= !ok;
+
+		tfail |= fail;
+	}
+#endif
+
+#if 1
+	set_uenv(4, 7);
+	{
+#define NB 1000
+		ubnd_s u[NB];
+		UB_VAR(x);
+		upack_s v;
+		upack_iter_s it;
+		int e, i, j, ok, fail = 0;
+
+		printf("\n# test packed vector, env:0,0 2,3 3,5 4,7 #\n");
+		ubnd_init_n(u, NB);
+		for (e = 0; e < 4; e++) {
+			if (e == 0) set_uenv(0, 0);
+			else if (e == 1) set_uenv(2, 3);
+			else if (e == 2) set_uenv(3, 5);
+			else set_uenv(4, 7);
+			upack_init(&v);
+			for (i = 0; i < NB; i++) {
+				d2ub(&u[i], (rand() - RAND_MAX/2) / (double)(i+1));
+				if (i % 3 == 0) plusu(&u[i], &u[i], &u[i/2]); /* inexact or pair */
+				else if (i % 3 == 1) guessu(u[i].l, &u[i]), u[i].p = 0;
+				upack_push(&v, &u[i]);
+			}
+#define SAMEU(a,b) ((a)->p == (b)->p && mpx_cmp((a)->l, (b)->l) == 0 && \
+	(!(a)->p || mpx_cmp((a)->r, (b)->r) == 0))
+			ok = 1;
+			upack_begin(&it, &v, 0);
+			for (i = 0; upack_next(x, &it); i++) ok &= i < NB && SAMEU(x, &u[i]);
+			ok &= i == NB;
+			for (j = 0; j < 300; j++) {
+				i = rand() % NB;
+				upack_get(x, &v, i);
+				ok &= SAMEU(x, &u[i]);
+			}
+#undef SAMEU
+			printf("%s env %d,%d: %lu bytes packed, %lu unpacked\n", ok ? "OK  " : "FAIL",
+				esizesize, fsizesize, (unsigned long)(v.nbits + 7) / 8,
+				(unsigned long)(NB * (2*sizeof(mp_limb_t)*NLIMBS + 1)));
+			fail |= !ok;
+			upack_clear(&v);
+		}
+		ubnd_clear_n(u, NB);
+#undef NB
+		tfail |= fail;
+	}
+#endif
+
+#if 1
+	set_uenv(3, 10);
+	{
+#define NB 64
+		ubnd_s x[NB], y[NB];
+		UB_VAR(ubf);
+		UB_VAR(ubs);
+		UB_VAR(ubt);
+		gbnd_t gf, gs;
+		mpf_t f, t;
+		int e, i, k, ok, fail = 0;
+
+		for (i = 0; i < NB; i++) {
+			ubnd_init(&x[i]);
+			ubnd_init(&y[i]);
+		}
+		gbnd_init(gf);
+		gbnd_init(gs);
+		mpf_init2(f, 1024);
+		mpf_init2(t, 1024);
+		printf("\n# test fused operations, env:3,4 3,5 4,5 3,10 #\n");
+		for (e = 0; e < 2; e++) {
+			if (e == 0) set_uenv(3, 4); else set_uenv(3, 5);
+			/* cancellation is exact */
+			d2ub(&x[0], 1048576.0); d2ub(&y[0], 3.0);
+			d2ub(&x[1], 0.75); d2ub(&y[1], 1.0);
+			d2ub(&x[2], -3.0); d2ub(&y[2], 1048576.0);
+			fdotu(ubf, x, y, 3);
+			d2ub(ubt, 0.75);
+			fail |= !(ok = ubf->p == 0 && mpx_cmp(ubf->l, ubt->l) == 0);
+			if (!ok) {printf("FAIL cancellation "); print_ub(ubf); putchar('\n');}
+			d2ub(&y[0], 3145728.0); d2ub(&y[1], 0.75); d2ub(&y[2], -3145728.0);
+			fsumu(ubf, y, 3);
+			fail |= !(ok = ubf->p == 0 && mpx_cmp(ubf->l, ubt->l) == 0);
+			if (!ok) {printf("FAIL fsumu cancellation "); print_ub(ubf); putchar('\n');}
+			/* contains the exact value and is no wider than the unfused sum */
+			for (k = 0; k < 20; k++) {
+				int exact = 1;
+				mpf_set_ui(f, 0);
+				d2ub(ubs, 0.0);
+				for (i = 0; i < NB; i++) {
+					d2ub(&x[i], (rand() % 4096 - 2048) / 64.0);
+					d2ub(&y[i], (rand() % 256 - 128) * ((k & 2) ? 1024.0 : 1.0/512));
+					if ((k & 1) && i % 8 == 7) plusu(&y[i], &y[i], &x[i]);
+					exact &= !x[i].p && !y[i].p && !inexQ(x[i].l) && !inexQ(y[i].l);
+					mpf_set_d(t, ub2d(&x[i]) * ub2d(&y[i]));
+					mpf_add(f, f, t);
+					timesu(ubt, &x[i], &y[i]);
+					plusu(ubs, ubs, ubt);
+				}
+				fdotu(ubf, x, y, NB);
+				u2g(gf, ubf);
+				u2g(gs, ubs);
+				ok = cmp_gn(&gf->l, LE, &gs->l, LE) >= 0 && cmp_gn(&gf->r, RE, &gs->r, RE) <= 0;
+				if (exact) ok = ok && mpf_cmp(gf->l.f, f) <= 0 && mpf_cmp(f, gf->r.f) <= 0;
+				fail |= !ok;
+				if (!ok) {printf("FAIL k:%d ", k); print_ub(ubf); printf(" vs "); print_ub(ubs); putchar('\n');}
+				/* fsumu, fprodu and fprodratiou against the unfused loops */
+				for (i = 0; i < 4; i++) if (ub2d(&x[i]) == 0) d2ub(&x[i], 0.375);
+				for (i = 0; i < 3; i++) {
+					int j, m = (i == 0) ? NB : 8;
+					ubnd_copy(ubs, (i == 0) ? &x[0] : &y[0]);
+					for (j = 1; j < m; j++) {
+						if (i == 0) plusu(ubs, ubs, &x[j]);
+						else timesu(ubs, ubs, &y[j]);
+					}
+					if (i == 2) for (j = 0; j < 4; j++) divideu(ubs, ubs, &x[j]);
+					if (i == 0) fsumu(ubf, x, NB);
+					else if (i == 1) fprodu(ubf, y, 8);
+					else fprodratiou(ubf, y, 8, x, 4);
+					u2g(gf, ubf);
+					u2g(gs, ubs);
+					ok = cmp_gn(&gf->l, LE, &gs->l, LE) >= 0 && cmp_gn(&gf->r, RE, &gs->r, RE) <= 0;
+					fail |= !ok;
+					if (!ok) {printf("FAIL fused:%d ", i); print_ub(ubf); printf(" vs "); print_ub(ubs); putchar('\n');}
+				}
+			}
+		}
+		printf("%s fdotu, fsumu, fprodu and fprodratiou against unfused operations\n", fail ? "FAIL" : "OK  ");
+
+		/* terms far apart and products wider than PBITS stay exact */
+		mpf_set_prec(f, 4096);
+		mpf_set_prec(t, 4096);
+		set_uenv(4, 5);
+		d2ub(&x[0], 1.0); d2ub(&x[1], ldexp(1.0, -1000));
+		d2ub(&y[0], 1.0); d2ub(&y[1], ldexp(1.0, -500));
+		mpf_set_ui(f, 1); mpf_div_2exp(f, f, 1000); mpf_add_ui(f, f, 1);
+		for (i = 0; i < 2; i++) {
+			if (i == 0) fsumu(ubf, x, 2); else fdotu(ubf, y, y, 2);
+			u2g(gf, ubf);
+			ok = gf->l.open && gf->r.open && mpf_cmp(gf->l.f, f) < 0 && mpf_cmp(f, gf->r.f) < 0;
+			printf("%s env:4,5 %s 1+2^-1000 ", ok ? "OK  " : "FAIL", i ? "fdotu" : "fsumu");
+			print_ub(ubf); putchar('\n');
+			fail |= !ok;
+		}
+		set_uenv(3, 10);
+		{
+			GB_VAR(g);
+			UB_VAR(z);
+
+			/* x = 1+2^-1023 and z = -(1+2^-1022), x*x+z = 2^-2046 underflows */
+			mpf_set_ui(f, 1); mpf_div_2exp(f, f, 1023); mpf_add_ui(f, f, 1);
+			mpf_set(g.l.f, f); mpf_set(g.r.f, f);
+			g2u(&x[0], &g);
+			mpf_set_ui(t, 1); mpf_div_2exp(t, t, 1022); mpf_add_ui(t, t, 1); mpf_neg(t, t);
+			mpf_set(g.l.f, t); mpf_set(g.r.f, t);
+			g2u(z, &g);
+			fmau(ubf, &x[0], &x[0], z);
+			d2ub(ubt, 0.0);
+			ok = gtuQ(ubf, ubt);
+			printf("%s env:3,10 fmau (1+2^-1023)^2-(1+2^-1022) ", ok ? "OK  " : "FAIL");
+			print_ub(ubf); putchar('\n');
+			fail |= !ok;
+			/* x^3/x^2 needs 3001 bits before the division */
+			for (i = 1; i < 3; i++) ubnd_copy(&x[i], &x[0]);
+			fprodratiou(ubf, x, 3, x, 2);
+			ok = sameuQ(ubf, &x[0]) && !ubf->p && !inexQ(ubf->l);
+			fprodu(ubs, x, 3);
+			mpf_pow_ui(t, f, 3);
+			u2g(gs, ubs);
+			ok = ok && gs->l.open && mpf_cmp(gs->l.f, t) < 0 && mpf_cmp(t, gs->r.f) < 0;
+			printf("%s env:3,10 fprodratiou x^3/x^2 is x, fprodu x^3 contains it\n", ok ? "OK  " : "FAIL");
+			fail |= !ok;
+		}
+
+		mpf_clear(f);
+		mpf_clear(t);
+		gbnd_clear(gf);
+		gbnd_clear(gs);
+		for (i = 0; i < NB; i++) {
+			ubnd_clear(&x[i]);
+			ubnd_clear(&y[i]);
+		}
+#undef NB
+		tfail |= fail;
+	}
+#endif
+
+#if 1
+	set_uenv(4, 7);
+	{
+		UB_VAR(x);
+		UB_VAR(y);
+		UB_VAR(z);
+		UB_VAR(a);
+		UB_VAR(b);
+		int e, i, d, ok, pairs = 0, fail = 0;
+
+		printf("\n# test deferred unify, env:3,4 4,7 #\n");
+		for (e = 0; e < 2; e++) {
+			if (e == 0) set_uenv(3, 4); else set_uenv(4, 7);
+			for (d = 0; d < 2; d++) {
+				ubnd_s *r = d ? b : a;
+				unify_defer(d);
+				d2ub(r, 0.1);
+				d2ub(y, 1.01);
+				d2ub(z, 0.3);
+				for (i = 0; i < 20; i++) {
+					timesu(x, r, y);
+					plusu(r, x, z);
+					if (d) pairs += r->p;
+				}
+			}
+			unify_defer(0);
+			/* the pair holds the same set, unifyeq gives the same encoding */
+			ok = sameuQ(a, b);
+			unifyeq(b, b);
+			ok = ok && a->p == b->p && mpx_cmp(a->l, b->l) == 0 && (!a->p || mpx_cmp(a->r, b->r) == 0);
+			printf("%s ", ok ? "OK  " : "FAIL"); print_ub(b); putchar('\n');
+			fail |= !ok;
+		}
+		/* the default is to unify, so deferring must leave pairs */
+		fail |= !(ok = pairs > 0 && unify_defer(0) == 0);
+		printf("%s %d deferred pairs\n", ok ? "OK  " : "FAIL", pairs);
+
+		tfail |= fail;
+	}
+#endif
+
+#if 1
+	set_uenv(4, 7);
+	{
+		UB_VAR(x);
+		UB_VAR(y);
+		UB_VAR(z);
+		UB_VAR(a);
+		UB_VAR(b);
+		MPF_VAR(ratio);
+		ustats_t st;
+		long long bits[2];
+		int e, i, s, ok, on, fail = 0;
+
+		printf("\n# test smart unify, env:3,4 4,7 #\n");
+		on = ustats_enable(1);
+		for (e = 0; e < 2; e++) {
+			if (e == 0) set_uenv(3, 4); else set_uenv(4, 7);
+			for (s = 0; s < 2; s++) {
+				ubnd_s *r = s ? b : a;
+				unify_smart(s ? 0.25 : 0);
+				ustats_reset();
+				d2ub(r, 0.1);
+				d2ub(y, 1.01);
+				d2ub(z, 0.3);
+				for (i = 0; i < 20; i++) {
+					timesu(x, r, y);
+					plusu(r, x, z);
+				}
+				ustats_get(&st);
+				bits[s] = st.ubitsmoved;
+			}
+			unify_smart(0);
+			/* fewer bits moved, and the smart result contains the eager one */
+			ok = bits[1] < bits[0] &&
+				cmpuQ(b, LE, a, LE) <= 0 && cmpuQ(b, RE, a, RE) >= 0;
+			/* a large ratio never loses accuracy, a tiny one always unifies */
+			mpf_set_d(ratio, 1e9);
+			smartunify(x, a, ratio);
+			ok = ok && a->p && sameuQ(x, a);
+			mpf_set_d(ratio, 1e-9);
+			smartunify(x, a, ratio);
+			unify(y, a);
+			ok = ok && sameuQ(x, y) && !x->p;
+			printf("%s %lld bits moved, %lld with ratio 0.25 ", ok ? "OK  " : "FAIL", bits[0], bits[1]);
+			print_ub(b); putchar('\n');
+			fail |= !ok;
+		}
+		ustats_enable(on);
+
+		tfail |= fail;
+	}
+#endif
+
+#if 1
+	{
+		uenv_job ref[2] = {{2, 3}, {4, 7}}, job[8];
+		pthread_t tid[8];
+		int i, ok = 1;
+
+		printf("\n# test per-thread environments #\n");
+		uenv_work(&ref[0]);
+		uenv_work(&ref[1]);
+		for (i = 0; i < 8; i++) {
+			job[i].e = ref[i&1].e;
+			job[i].f = ref[i&1].f;
+			if (pthread_create(&tid[i], NULL, uenv_work, &job[i])) {
+				fprintf(stderr, " -- error: can't create thread\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		for (i = 0; i < 8; i++) {
+			pthread_join(tid[i], NULL);
+			ok &= strcmp(job[i].str, ref[i&1].str) == 0;
+		}
+		printf("%s 8 threads, env:%d,%d %s, env:%d,%d %s\n", ok ? "OK  " : "FAIL",
+			ref[0].e, ref[0].f, ref[0].str, ref[1].e, ref[1].f, ref[1].str);
+
+		tfail |= !ok;
+	}
+#endif
+
+#if 1
+	{
+		uenv_job job = {3, 4};
+		pthread_t tid[2];
+		ustats_t st;
+		long long int ops;
+		int i, ok;
+
+		printf("\n# test operation counts #\n");
+		ustats_enable(0);
+		ustats_reset();
+		uenv_work(&job);
+		ustats_get(&st);
+		ok = st.ops == 0;
+		ustats_enable(1);
+		uenv_work(&job);
+		ustats_get(&st);
+		ops = st.ops;
+		ok = ok && ops > 0 && st.ubndsmoved > 2*ops;
+		ustats_reset();
+		for (i = 0; i < 2; i++) pthread_create(&tid[i], NULL, uenv_work, &job);
+		uenv_work(&job);
+		for (i = 0; i < 2; i++) pthread_join(tid[i], NULL);
+		ustats_get(&st);
+		ok = ok && st.ops == 3*ops;
+		printf("%s %lld operations in 3 threads\n", ok ? "OK  " : "FAIL", st.ops);
+		ustats_enable(0);
+
+		tfail |= !ok;
+	}
+#endif
+
+#if 1
+	set_uenv(4, 7);
+	{
+		UB_VAR(ub1);
+		UB_VAR(ub2);
+		UB_VAR(ubr);
+		static const int envs[][2] = {{4,7}, {3,4}};
+		int e, i, ok, fail = 0;
+
+		printf("\n# test heap allocation, env:4,7 3,4 #\n");
+		mp_get_memory_functions(&gmp_alloc, &gmp_realloc, &gmp_free);
+		for (e = 0; e < 2; e++) {
+			set_uenv(envs[e][0], envs[e][1]);
+			sscan_ub("(23.1,23.9)", ub1);
+			sscan_ub("0.1", ub2);
+			/* count GMP heap calls after one warm-up pass */
+			for (i = 0; i < 2; i++) {
+				if (i) {
+					gmp_calls = 0;
+					mp_set_memory_functions(count_alloc, count_realloc, count_free);
+				}
+				plusu(ubr, ub1, ub2);
+				timesu(ubr, ub1, ub2);
+				divideu(ubr, ub1, ub2);
+				sqrtu(ubr, ub1);
+				ltuQ(ub1, ub2);
+				unify(ubr, ub1);
+			}
+			mp_set_memory_functions(gmp_alloc, gmp_realloc, gmp_free);
+			fail |= !(ok = gmp_calls == 0);
+			printf("%s env:%d,%d %lu GMP heap calls\n", ok ? "OK  " : "FAIL",
+				esizesize, fsizesize, gmp_calls);
+		}
+
+		tfail |= fail;
+	}
+#endif
+
 	clear_uenv();
 	printf("\ntest %s\n", tfail ? "FAIL" : "OK");
 	return(tfail ? EXIT_FAILURE : EXIT_SUCCESS);
@@ -7,11 +7,24 @@ $Log: $
 */
 
 #include <iostream> // cout, endl
+#include <vector>
+#include <cmath> // ldexp
 
 #include "unumxx.h"
 
 using namespace std;
 
+#if __UNUMXX_USE_CXX11
+static size_t allocs;
+static void *(*gmp_alloc)(size_t);
+
+static void *count_alloc(size_t n)
+{
+	allocs++;
+	return gmp_alloc(n);
+}
+#endif
+
 int main(int argc, char** argv)
 {
 #if 1
@@ -38,6 +51,128 @@ int main(int argc, char** argv)
 	d += a;
 	d /= 2;
 	cout << "d is " << d << endl;
+#endif
+#if 1
+	{
+		/* a*b+c evaluates with fmau, so 1025*1023 is not rounded */
+		set_uenv(3, 4);
+		ubnd_c x(1025), y(1023), z(-1048576), r, s;
+
+		r = x * y + z;
+		s = z + x * y;
+		cout << "x * y + z is " << r << ", z + x * y is " << s << endl;
+		if (!(r == -1 && s == -1)) return EXIT_FAILURE;
+		r = x * y;
+		r += z;
+		cout << "unfused x * y + z is " << r << endl;
+	}
+	{
+		/* x*x needs 2047 bits, more than PBITS, and x*x+z = 2^-2046 */
+		set_uenv(3, 10);
+		ubnd_c one(1), x = one + ldexp(1.0, -1023), z = -(one + ldexp(1.0, -1022)), r, s;
+
+		r = x * x + z;
+		s = glayer(x * x + z);
+		if (!(r > 0 && sameuQ(r.__get_mp(), s.__get_mp()))) return EXIT_FAILURE;
+	}
+#endif
+#if 1
+	{
+		/* glayer() rounds to a ubound once, after the whole expression */
+		set_uenv(2, 3);
+		ubnd_c a("0.3"), b(2), c(5), d("0.7"), e(3), r, s;
+
+		r = (a + b) * (c - d) / e;
+		s = glayer((a + b) * (c - d) / e);
+		cout << "(a + b) * (c - d) / e is " << r << ", in the g-layer " << s << endl;
+#if !defined(AUTO_GUESS)
+		if (cmpuQ(s.__get_mp(), LE, r.__get_mp(), LE) < 0 ||
+			cmpuQ(s.__get_mp(), RE, r.__get_mp(), RE) > 0) return EXIT_FAILURE;
+#endif
+	}
+#endif
+#if 1
+	{
+		/* deferred() unifies only the result, which is the same as eager */
+		set_uenv(3, 5);
+		ubnd_c a("0.3"), b(2), c(5), d("0.7"), e(3), r, s;
+
+		r = (a + b) * (c - d) / e - a;
+		s = deferred((a + b) * (c - d) / e - a);
+		cout << "deferred (a + b) * (c - d) / e - a is " << s << endl;
+#if !defined(AUTO_GUESS)
+		if (!sameuQ(r.__get_mp(), s.__get_mp()) || r.__get_mp()->p != s.__get_mp()->p)
+			return EXIT_FAILURE;
+#endif
+	}
+#endif
+#if __UNUMXX_USE_CXX11
+	{
+		/* moving a ubnd_c does not allocate */
+		vector<ubnd_c> v;
+		ubnd_c t(7);
+
+		for (int i = 0; i < 100; i++) v.push_back(ubnd_c(i));
+		mp_get_memory_functions(&gmp_alloc, NULL, NULL);
+		mp_set_memory_functions(count_alloc, NULL, NULL);
+		v.reserve(4 * v.capacity());
+		swap(v[0], v[1]);
+		t = std::move(v[2]);
+		ubnd_c u(std::move(t));
+		mp_set_memory_functions(gmp_alloc, NULL, NULL);
+		cout << "allocations while moving " << allocs << endl;
+		if (allocs != 0 || u != 2 || v[0] != 1) return EXIT_FAILURE;
+		v[2] = 5;
+		if (v[2] != 5) return EXIT_FAILURE;
+	}
+	{
+		/* ubnd<E,F> uses its own environment and restores the caller's */
+		typedef ubnd<2, 3> u23;
+		typedef ubnd<3, 5> u35;
+		u23 x(3), y = x / 7;
+		u35 z(x), w = z / 7;
+
+		cout << "3/7 is " << y << " in 2,3 and " << w << " in 3,5" << endl;
+		if (!(u23(w) == y && y < x && x + 1 == u23(4))) return EXIT_FAILURE;
+		set_uenv(4, 6);
+		w = z * z + 1;
+		if (esizesize != 4 || fsizesize != 6 || !(w > z)) return EXIT_FAILURE;
+		set_uenv(2, 3);
+		if (ulimbs != u23::env::ulimbs || u35::env::maxubits != 50) return EXIT_FAILURE;
+	}
+#if defined(HAVE_UBND64)
+	{
+		/* ubnd<2,3> runs natively while the thread is in another
+		   environment, and agrees with the library in (2,3) */
+		typedef ubnd<2, 3> u23;
+		set_uenv(4, 6);
+		UB_VAR(r); UB_VAR(t);
+		int save = uenv64, bad = 0;
+		const uenv_s *cur = cur_uenv();
+		for (int i = -10; i <= 10; i++)
+			for (int j = -10; j <= 10; j++) {
+				u23 x = u23(i) / 4, y = (j & 1) ? u23(j) / 3 : u23(j) / 8;
+				u23 q[] = {x + y, x - y, x * y, x * x, x / y, sqrt(x)};
+				bool c[] = {x == y, x < y, x > y};
+				if (cur_uenv() != cur) bad++;
+				set_uenv(2, 3);
+				uenv64 = 0;
+				plusu(r, x.get_ubnd_t(), y.get_ubnd_t()); bad += !sameuQ(r, q[0].get_ubnd_t());
+				minusu(r, x.get_ubnd_t(), y.get_ubnd_t()); bad += !sameuQ(r, q[1].get_ubnd_t());
+				timesu(r, x.get_ubnd_t(), y.get_ubnd_t()); bad += !sameuQ(r, q[2].get_ubnd_t());
+				squareu(r, x.get_ubnd_t()); bad += !sameuQ(r, q[3].get_ubnd_t());
+				divideu(r, x.get_ubnd_t(), y.get_ubnd_t()); bad += !sameuQ(r, q[4].get_ubnd_t());
+				sqrtu(t, x.get_ubnd_t()); bad += !sameuQ(t, q[5].get_ubnd_t());
+				bad += c[0] != (sameuQ(x.get_ubnd_t(), y.get_ubnd_t()) != 0);
+				bad += c[1] != (ltuQ(x.get_ubnd_t(), y.get_ubnd_t()) != 0);
+				bad += c[2] != (gtuQ(x.get_ubnd_t(), y.get_ubnd_t()) != 0);
+				uenv64 = save;
+				use_uenv(cur);
+			}
+		cout << "native ubnd<2,3> mismatches " << bad << endl;
+		if (bad || esizesize != 4 || fsizesize != 6) return EXIT_FAILURE;
+	}
+#endif
 #endif
 	set_uenv(4, 6);
 	ubnd_c sum = 0.0;